@@ -0,0 +1,127 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+#include <vector>
+
+#include "rooted_tree.hpp"
+
+namespace sax {
+
+// Depth and ancestor queries over the sub-tree rooted at rid_ of a tree (or a mapped_rooted_tree), in O(log n).
+// Every node stores its depth and one jump pointer (Myers' skew-binary scheme), the jump of a node only depends
+// on its parent's, which makes building it parallel and appending a leaf O(1). The index refers to the tree, and
+// is not updated by changes to it, but for append ( ).
+template<typename Tree>
+class ancestor_index {
+
+    public:
+    using nid       = typename Tree::nid;
+    using size_type = typename Tree::size_type;
+
+    explicit ancestor_index ( Tree const & tree_, nid rid_ = Tree::root ) : tree{ tree_ }, rid{ rid_ } {
+        std::size_t const size = static_cast<std::size_t> ( tree.end ( ) - tree.begin ( ) );
+        depths.resize ( size );
+        jumps.resize ( size );
+        depths[ rid.id ] = 0;
+        jumps[ rid.id ]  = rid;
+        detail::parallel_visit ( tree, rid, [ this ] ( nid n_ ) {
+            if ( n_ != rid )
+                link ( n_ );
+        } );
+    }
+
+    // Not safe/concurrent. Indexes nid_, a leaf added to the tree after building the index.
+    void append ( nid nid_ ) {
+        if ( static_cast<std::size_t> ( nid_.id ) >= depths.size ( ) ) {
+            std::size_t const size = static_cast<std::size_t> ( tree.end ( ) - tree.begin ( ) );
+            depths.resize ( size );
+            jumps.resize ( size );
+        }
+        link ( nid_ );
+    }
+
+    // The number of edges between rid and nid_.
+    [[nodiscard]] size_type depth ( nid nid_ ) const noexcept { return depths[ nid_.id ]; }
+
+    // The ancestor of nid_ at depth_ (nid_ itself at its own depth), invalid if depth_ is larger.
+    [[nodiscard]] nid level_ancestor ( nid nid_, size_type depth_ ) const noexcept {
+        if ( depth_ > depths[ nid_.id ] )
+            return Tree::invalid;
+        while ( depths[ nid_.id ] != depth_ )
+            nid_ = depths[ jumps[ nid_.id ].id ] < depth_ ? tree.hook ( nid_ ).up : jumps[ nid_.id ];
+        return nid_;
+    }
+
+    // The k_-th ancestor of nid_ (the parent being the 1st), invalid if there is no such node.
+    [[nodiscard]] nid ancestor ( nid nid_, size_type k_ ) const noexcept {
+        return k_ > depths[ nid_.id ] ? Tree::invalid : level_ancestor ( nid_, static_cast<size_type> ( depths[ nid_.id ] - k_ ) );
+    }
+
+    // Whether a_ is b_, or an ancestor of it.
+    [[nodiscard]] bool is_ancestor ( nid a_, nid b_ ) const noexcept { return level_ancestor ( b_, depths[ a_.id ] ) == a_; }
+
+    // The lowest common ancestor of a_ and b_.
+    [[nodiscard]] nid lca ( nid a_, nid b_ ) const noexcept {
+        if ( depths[ a_.id ] > depths[ b_.id ] )
+            a_ = level_ancestor ( a_, depths[ b_.id ] );
+        else
+            b_ = level_ancestor ( b_, depths[ a_.id ] );
+        // At equal depth, the jumps of a_ and b_ land at equal depth as well.
+        while ( a_ != b_ ) {
+            if ( jumps[ a_.id ] != jumps[ b_.id ] ) {
+                a_ = jumps[ a_.id ];
+                b_ = jumps[ b_.id ];
+            }
+            else {
+                a_ = tree.hook ( a_ ).up;
+                b_ = tree.hook ( b_ ).up;
+            }
+        }
+        return a_;
+    }
+
+    private:
+    // Sets depth and jump of nid_ from those of its parent.
+    void link ( nid nid_ ) noexcept {
+        nid const up = tree.hook ( nid_ ).up, jump = jumps[ up.id ];
+        assert ( up.is_valid ( ) );
+        depths[ nid_.id ] = static_cast<size_type> ( depths[ up.id ] + 1 );
+        // Two jumps of equal length merge into one twice as long (plus one).
+        if ( depths[ up.id ] - depths[ jump.id ] == depths[ jump.id ] - depths[ jumps[ jump.id ].id ] )
+            jumps[ nid_.id ] = jumps[ jump.id ];
+        else
+            jumps[ nid_.id ] = up;
+    }
+
+    Tree const & tree;
+    nid rid;
+    std::vector<size_type> depths;
+    detail::basic_id_vector<nid> jumps;
+};
+
+} // namespace sax
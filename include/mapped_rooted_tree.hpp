@@ -0,0 +1,331 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#if defined( _MSC_VER )
+
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+
+#    ifndef _AMD64_
+#        define _AMD64_
+#    endif
+
+#    ifndef WIN32_LEAN_AND_MEAN
+#        define WIN32_LEAN_AND_MEAN_DEFINED
+#        define WIN32_LEAN_AND_MEAN
+#    endif
+
+#    include <windef.h>
+#    include <WinBase.h>
+
+#    ifdef WIN32_LEAN_AND_MEAN_DEFINED
+#        undef WIN32_LEAN_AND_MEAN_DEFINED
+#        undef WIN32_LEAN_AND_MEAN
+#    endif
+
+#else
+
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "rooted_tree.hpp"
+
+// A flat, native-endian, file format for a rooted_tree with trivially copyable payloads: a header, the hook array
+// and the payload array (both indexed by nid, sentinel included, at 64-byte aligned offsets). A mapped_rooted_tree
+// maps such a file read-only and is iterated in place, no parsing takes place.
+
+namespace sax {
+
+namespace detail {
+
+struct mapped_header { // 64 bytes.
+    char magic[ 8 ];
+    std::uint32_t version, hook_size, value_size, reserved;
+    std::uint64_t size, hooks_offset, nodes_offset, file_size;
+    char padding[ 16 ];
+};
+
+inline constexpr char mapped_magic[ 8 ]       = { 'S', 'A', 'X', 'R', 'T', 'R', 'E', 'E' };
+inline constexpr std::uint32_t mapped_version = 1;
+inline constexpr std::uint64_t mapped_align   = 64;
+
+[[nodiscard]] constexpr std::uint64_t mapped_align_up ( std::uint64_t offset_ ) noexcept {
+    return ( offset_ + mapped_align - 1 ) & ~( mapped_align - 1 );
+}
+
+template<typename Hook, typename Node>
+[[nodiscard]] mapped_header make_mapped_header ( std::uint64_t size_ ) noexcept {
+    mapped_header header{ };
+    std::memcpy ( header.magic, mapped_magic, sizeof ( mapped_magic ) );
+    header.version      = mapped_version;
+    header.hook_size    = sizeof ( Hook );
+    header.value_size   = sizeof ( Node );
+    header.size         = size_;
+    header.hooks_offset = mapped_align_up ( sizeof ( mapped_header ) );
+    header.nodes_offset = mapped_align_up ( header.hooks_offset + size_ * sizeof ( Hook ) );
+    header.file_size    = header.nodes_offset + size_ * sizeof ( Node );
+    return header;
+}
+
+struct file_closer {
+    void operator( ) ( std::FILE * file_ ) const noexcept { std::fclose ( file_ ); }
+};
+
+// Writes count_ elements, get_ ( i ) returns the i-th, through a buffer (the tree's storage is not necessarily
+// contiguous), after padding the file from end_ to offset_.
+template<typename T, typename Get>
+void write_array ( std::FILE * file_, std::uint64_t end_, std::uint64_t offset_, std::uint64_t count_, Get && get_ ) {
+    static char const zeros[ mapped_align ]{ };
+    if ( std::size_t const pad = static_cast<std::size_t> ( offset_ - end_ ); std::fwrite ( zeros, 1, pad, file_ ) != pad )
+        throw std::runtime_error ( "rooted_tree: write failed" );
+    constexpr std::uint64_t buffer_size = std::max<std::uint64_t> ( 1, 65'536 / sizeof ( T ) );
+    std::unique_ptr<T[]> buffer{ new T[ buffer_size ] };
+    for ( std::uint64_t i = 0; i < count_; ) {
+        std::uint64_t const n = std::min ( buffer_size, count_ - i );
+        for ( std::uint64_t j = 0; j < n; ++j, ++i )
+            std::memcpy ( buffer.get ( ) + j, std::addressof ( get_ ( i ) ), sizeof ( T ) );
+        if ( std::fwrite ( buffer.get ( ), sizeof ( T ), n, file_ ) != n )
+            throw std::runtime_error ( "rooted_tree: write failed" );
+    }
+}
+
+// A read-only view of a whole file.
+class mapped_file {
+    void const * address = nullptr;
+    std::size_t length   = 0;
+
+    public:
+    mapped_file ( ) noexcept = default;
+    explicit mapped_file ( char const * path_ ) {
+#if defined( _MSC_VER )
+        HANDLE file = CreateFileA ( path_, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+        if ( INVALID_HANDLE_VALUE == file )
+            throw std::runtime_error ( "rooted_tree: cannot open file" );
+        LARGE_INTEGER size;
+        if ( not GetFileSizeEx ( file, &size ) or not size.QuadPart ) {
+            CloseHandle ( file );
+            throw std::runtime_error ( "rooted_tree: cannot size file" );
+        }
+        HANDLE mapping = CreateFileMappingA ( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        CloseHandle ( file );
+        if ( not mapping )
+            throw std::runtime_error ( "rooted_tree: cannot map file" );
+        address = MapViewOfFile ( mapping, FILE_MAP_READ, 0, 0, 0 );
+        CloseHandle ( mapping ); // The view keeps the mapping alive.
+        if ( not address )
+            throw std::runtime_error ( "rooted_tree: cannot map file" );
+        length = static_cast<std::size_t> ( size.QuadPart );
+#else
+        int const file = open ( path_, O_RDONLY );
+        if ( -1 == file )
+            throw std::runtime_error ( "rooted_tree: cannot open file" );
+        struct stat status;
+        if ( -1 == fstat ( file, &status ) or not status.st_size ) {
+            close ( file );
+            throw std::runtime_error ( "rooted_tree: cannot size file" );
+        }
+        void * view = mmap ( nullptr, static_cast<std::size_t> ( status.st_size ), PROT_READ, MAP_SHARED, file, 0 );
+        close ( file ); // The mapping keeps the file alive.
+        if ( MAP_FAILED == view )
+            throw std::runtime_error ( "rooted_tree: cannot map file" );
+        address = view;
+        length  = static_cast<std::size_t> ( status.st_size );
+#endif
+    }
+
+    mapped_file ( mapped_file const & ) = delete;
+    mapped_file ( mapped_file && rhs_ ) noexcept :
+        address{ std::exchange ( rhs_.address, nullptr ) }, length{ std::exchange ( rhs_.length, 0 ) } {}
+
+    ~mapped_file ( ) noexcept {
+        if ( address ) {
+#if defined( _MSC_VER )
+            UnmapViewOfFile ( address );
+#else
+            munmap ( const_cast<void *> ( address ), length );
+#endif
+        }
+    }
+
+    mapped_file & operator= ( mapped_file const & ) = delete;
+    mapped_file & operator= ( mapped_file && rhs_ ) noexcept {
+        std::swap ( address, rhs_.address );
+        std::swap ( length, rhs_.length );
+        return *this;
+    }
+
+    [[nodiscard]] char const * data ( ) const noexcept { return static_cast<char const *> ( address ); }
+    [[nodiscard]] std::size_t size ( ) const noexcept { return length; }
+};
+
+} // namespace detail
+
+// Writes tree_ (nids are preserved, erased nodes included, relayout ( ) first to drop those) to path_, not
+// safe/concurrent.
+template<typename Tree>
+void write_mapped ( Tree const & tree_, char const * path_ ) {
+    using hook_type  = typename Tree::hook_type;
+    using value_type = typename Tree::value_type;
+    using index_type = typename Tree::index_type;
+    using nid        = typename Tree::nid;
+    static_assert ( std::is_trivially_copyable<hook_type>::value and std::is_trivially_copyable<value_type>::value,
+                    "the payload must be trivially copyable" );
+    std::unique_ptr<std::FILE, detail::file_closer> file{ std::fopen ( path_, "wb" ) };
+    if ( not file )
+        throw std::runtime_error ( "rooted_tree: cannot open file" );
+    std::uint64_t const size           = static_cast<std::uint64_t> ( tree_.nodes.size ( ) );
+    detail::mapped_header const header = detail::make_mapped_header<hook_type, value_type> ( size );
+    if ( std::fwrite ( &header, sizeof ( header ), 1, file.get ( ) ) != 1 )
+        throw std::runtime_error ( "rooted_tree: write failed" );
+    auto get_hook = [ &tree_ ] ( std::uint64_t i_ ) -> hook_type const & {
+        return tree_.hook ( nid{ static_cast<index_type> ( i_ ) } );
+    };
+    auto get_node = [ &tree_ ] ( std::uint64_t i_ ) -> value_type const & {
+        return tree_[ nid{ static_cast<index_type> ( i_ ) } ];
+    };
+    std::uint64_t const hooks_end = header.hooks_offset + size * sizeof ( hook_type );
+    detail::write_array<hook_type> ( file.get ( ), sizeof ( header ), header.hooks_offset, size, get_hook );
+    detail::write_array<value_type> ( file.get ( ), hooks_end, header.nodes_offset, size, get_node );
+    if ( std::fflush ( file.get ( ) ) )
+        throw std::runtime_error ( "rooted_tree: write failed" );
+}
+
+// A read-only rooted_tree, backed by a file written by write_mapped ( ). Opening maps the file and checks that its
+// links form a tree (which reads all hooks, once), the payload pages are faulted in on first access. All const
+// iterators and the parallel algorithms work on it.
+template<typename Node, typename Hook = rooted_tree_hook>
+class mapped_rooted_tree {
+
+    static_assert ( std::is_trivially_copyable<Hook>::value and std::is_trivially_copyable<Node>::value,
+                    "the payload must be trivially copyable" );
+
+    public:
+    using value_type      = Node;
+    using hook_type       = Hook;
+    using index_type      = typename Hook::index_type;
+    using nid             = basic_nid<index_type>;
+    using size_type       = index_type;
+    using difference_type = std::make_signed_t<index_type>;
+    using reference       = value_type const &;
+    using pointer         = value_type const *;
+    using iterator        = value_type const *;
+    using const_reference = value_type const &;
+    using const_pointer   = value_type const *;
+    using const_iterator  = value_type const *;
+
+    private:
+    detail::mapped_file file;
+    Hook const * hooks = nullptr;
+    Node const * nodes = nullptr;
+    size_type count    = 0;
+
+    public:
+
+    explicit mapped_rooted_tree ( char const * path_ ) : file{ path_ } {
+        detail::mapped_header header;
+        if ( file.size ( ) < sizeof ( header ) )
+            throw std::runtime_error ( "rooted_tree: not a tree file" );
+        std::memcpy ( &header, file.data ( ), sizeof ( header ) );
+        if ( std::memcmp ( header.magic, detail::mapped_magic, sizeof ( header.magic ) ) or
+             detail::mapped_version != header.version )
+            throw std::runtime_error ( "rooted_tree: not a tree file" );
+        if ( sizeof ( Hook ) != header.hook_size or sizeof ( Node ) != header.value_size )
+            throw std::runtime_error ( "rooted_tree: node type mismatch" );
+        if ( not header.size or header.size - 1 > static_cast<std::uint64_t> ( std::numeric_limits<index_type>::max ( ) ) )
+            throw std::runtime_error ( "rooted_tree: truncated tree file" );
+        // Bounds the size by the file, before the offsets are computed from it, which then cannot overflow.
+        if ( header.size > ( file.size ( ) - sizeof ( header ) ) / ( sizeof ( Hook ) + sizeof ( Node ) ) )
+            throw std::runtime_error ( "rooted_tree: truncated tree file" );
+        detail::mapped_header const expected = detail::make_mapped_header<Hook, Node> ( header.size );
+        if ( expected.hooks_offset != header.hooks_offset or expected.nodes_offset != header.nodes_offset or
+             expected.file_size != header.file_size or file.size ( ) < header.file_size )
+            throw std::runtime_error ( "rooted_tree: truncated tree file" );
+        hooks = reinterpret_cast<Hook const *> ( file.data ( ) + header.hooks_offset );
+        nodes = reinterpret_cast<Node const *> ( file.data ( ) + header.nodes_offset );
+        count = static_cast<size_type> ( header.size );
+        validate ( );
+    }
+
+    [[nodiscard]] const_iterator begin ( ) const noexcept { return nodes; }
+    [[nodiscard]] const_iterator cbegin ( ) const noexcept { return nodes; }
+    [[nodiscard]] const_iterator end ( ) const noexcept { return nodes + count; }
+    [[nodiscard]] const_iterator cend ( ) const noexcept { return nodes + count; }
+    [[nodiscard]] value_type const & operator[] ( nid nid_ ) const noexcept { return nodes[ nid_.id ]; }
+    [[nodiscard]] value_type const & operator[] ( size_type nid_ ) const noexcept { return nodes[ nid_ ]; }
+
+    [[nodiscard]] hook_type const & hook ( nid nid_ ) const noexcept { return hooks[ nid_.id ]; }
+
+    // Number of nids, the sentinel included, 1 for an empty tree (without a root-node, not to be iterated).
+    [[nodiscard]] size_type size ( ) const noexcept { return count; }
+
+    using const_internal_iterator   = detail::basic_internal_iterator<mapped_rooted_tree const>;
+    using const_leaf_iterator       = detail::basic_leaf_iterator<mapped_rooted_tree const>;
+    using const_depth_iterator      = detail::basic_depth_iterator<mapped_rooted_tree const>;
+    using const_pre_order_iterator  = detail::basic_pre_order_iterator<mapped_rooted_tree const>;
+    using const_post_order_iterator = detail::basic_post_order_iterator<mapped_rooted_tree const>;
+    using const_breadth_iterator    = detail::basic_breadth_iterator<mapped_rooted_tree const>;
+    using const_out_iterator        = detail::basic_out_iterator<mapped_rooted_tree const>;
+    using const_up_iterator         = detail::basic_up_iterator<mapped_rooted_tree const>;
+
+    static constexpr nid invalid = nid{ 0 };
+    static constexpr nid root    = nid{ 1 };
+
+    // Number of nodes below which parallel algorithms don't split work.
+    static constexpr size_type grain_size = 4'096;
+
+    private:
+    // A damaged (or crafted) file is rejected, not walked out of bounds, or in circles: all links stay inside the
+    // file, and form a tree (see detail::is_tree ( )).
+    void validate ( ) const {
+        auto outside = [ size = static_cast<std::uint64_t> ( count ) ] ( nid nid_ ) noexcept { // Negative ones as well.
+            return static_cast<std::uint64_t> ( static_cast<std::make_unsigned_t<index_type>> ( nid_.id ) ) >= size;
+        };
+        for ( size_type i = 0; i < count; ++i )
+            if ( outside ( hooks[ i ].up ) or outside ( hooks[ i ].prev ) or outside ( hooks[ i ].tail ) )
+                throw std::runtime_error ( "rooted_tree: corrupt tree file" );
+        if ( not detail::is_tree ( *this, static_cast<std::uint64_t> ( count ) ) )
+            throw std::runtime_error ( "rooted_tree: corrupt tree file" );
+    }
+};
+
+} // namespace sax
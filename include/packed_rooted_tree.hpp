@@ -0,0 +1,252 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "rooted_tree.hpp"
+
+// A compact, streamed, file format for a rooted_tree with trivially copyable payloads. The links of a hook are
+// stored as zig-zag varint deltas relative to the node's own nid, fan-out as a varint, followed by the raw payload
+// (without an intrusive hook). Nodes are written and read in chunks, a chunk being framed by its node and byte
+// count. Only up, prev, tail and fan are stored, the depths (of a depth hook) are re-computed. The header holds the
+// payload size and the width of the index type, a stream is only read into a tree that matches both, and only if
+// its links form a tree.
+
+namespace sax {
+
+namespace detail {
+
+inline constexpr char packed_magic[ 8 ] = { 'S', 'A', 'X', 'R', 'T', 'P', 'K', '2' };
+inline constexpr int packed_chunk_size  = 4'096; // Nodes per chunk.
+
+[[nodiscard]] constexpr std::uint64_t zig_zag ( std::int64_t v_ ) noexcept {
+    return ( static_cast<std::uint64_t> ( v_ ) << 1 ) ^ static_cast<std::uint64_t> ( v_ >> 63 );
+}
+[[nodiscard]] constexpr std::int64_t zag_zig ( std::uint64_t v_ ) noexcept {
+    return static_cast<std::int64_t> ( v_ >> 1 ) ^ -static_cast<std::int64_t> ( v_ & 1 );
+}
+
+inline void put_varint ( std::vector<char> & buffer_, std::uint64_t v_ ) {
+    while ( v_ >= 0x80 ) {
+        buffer_.push_back ( static_cast<char> ( v_ | 0x80 ) );
+        v_ >>= 7;
+    }
+    buffer_.push_back ( static_cast<char> ( v_ ) );
+}
+
+// Reads from the range [ in_, end_ ), advances in_.
+[[nodiscard]] inline std::uint64_t get_varint ( char const *& in_, char const * end_ ) {
+    std::uint64_t v = 0;
+    for ( int shift = 0; shift < 64; shift += 7 ) {
+        if ( in_ == end_ )
+            break;
+        std::uint64_t const byte = static_cast<unsigned char> ( *in_++ );
+        v |= ( byte & 0x7f ) << shift;
+        if ( not( byte & 0x80 ) )
+            return v;
+    }
+    throw std::runtime_error ( "rooted_tree: corrupt packed tree" );
+}
+
+// Reads one varint byte by byte, for the (unbuffered) framing.
+[[nodiscard]] inline std::uint64_t get_varint ( std::istream & in_ ) {
+    char buffer[ 10 ];
+    int size = 0;
+    do {
+        if ( not in_.get ( buffer[ size ] ) )
+            throw std::runtime_error ( "rooted_tree: truncated packed tree" );
+    } while ( static_cast<unsigned char> ( buffer[ size++ ] ) & 0x80 and size < 10 );
+    char const * in = buffer;
+    return get_varint ( in, buffer + size );
+}
+
+// A link, 0 is invalid, a node never links to itself.
+template<typename Nid>
+[[nodiscard]] std::uint64_t encode_link ( Nid nid_, Nid link_ ) noexcept {
+    return link_.is_valid ( ) ? zig_zag ( static_cast<std::int64_t> ( link_.id ) - static_cast<std::int64_t> ( nid_.id ) ) : 0;
+}
+// The delta is range-checked (against the size_ nids) before the link is formed, which therefore cannot overflow.
+template<typename Nid>
+[[nodiscard]] Nid decode_link ( Nid nid_, std::uint64_t v_, std::uint64_t size_ ) {
+    if ( not v_ )
+        return Nid{ 0 };
+    std::uint64_t const id = static_cast<std::uint64_t> ( nid_.id ), distance = ( v_ >> 1 ) + ( v_ & 1 ); // Odd, negative.
+    if ( v_ & 1 ? distance >= id : distance >= size_ - id )
+        throw std::runtime_error ( "rooted_tree: corrupt packed tree" );
+    return Nid{ static_cast<typename Nid::index_type> ( v_ & 1 ? id - distance : id + distance ) };
+}
+
+// The bytes of a payload that are stored: all of it, less the hook if that is intrusive.
+template<typename Tree>
+struct packed_payload {
+    std::size_t hook_begin = 0, hook_end = 0;
+
+    explicit packed_payload ( Tree const & tree_ ) noexcept {
+        if constexpr ( not Tree::is_split::value ) {
+            char const * hook = reinterpret_cast<char const *> ( std::addressof ( tree_.hook ( Tree::invalid ) ) );
+            char const * node = reinterpret_cast<char const *> ( std::addressof ( tree_[ Tree::invalid ] ) );
+            hook_begin        = static_cast<std::size_t> ( hook - node );
+            hook_end          = hook_begin + sizeof ( typename Tree::hook_type );
+        }
+    }
+
+    [[nodiscard]] std::size_t size ( ) const noexcept { return sizeof ( typename Tree::value_type ) - ( hook_end - hook_begin ); }
+
+    void put ( std::vector<char> & buffer_, typename Tree::value_type const & node_ ) const {
+        char const * bytes = reinterpret_cast<char const *> ( std::addressof ( node_ ) );
+        buffer_.insert ( buffer_.end ( ), bytes, bytes + hook_begin );
+        buffer_.insert ( buffer_.end ( ), bytes + hook_end, bytes + sizeof ( typename Tree::value_type ) );
+    }
+    void get ( char const *& in_, char const * end_, typename Tree::value_type & node_ ) const {
+        if ( static_cast<std::size_t> ( end_ - in_ ) < size ( ) )
+            throw std::runtime_error ( "rooted_tree: corrupt packed tree" );
+        char * bytes = reinterpret_cast<char *> ( std::addressof ( node_ ) );
+        std::memcpy ( bytes, in_, hook_begin );
+        std::memcpy ( bytes + hook_end, in_ + hook_begin, sizeof ( typename Tree::value_type ) - hook_end );
+        in_ += size ( );
+    }
+};
+
+} // namespace detail
+
+// Writes tree_ (nids are preserved, erased nodes included, relayout ( ) first to drop those and to get the
+// smallest deltas) to out_ (opened in binary mode), not safe/concurrent.
+template<typename Tree>
+void write_packed ( Tree const & tree_, std::ostream & out_ ) {
+    using nid = typename Tree::nid;
+    static_assert ( std::is_trivially_copyable<typename Tree::value_type>::value, "the payload must be trivially copyable" );
+    detail::packed_payload<Tree> const payload{ tree_ };
+    std::uint64_t const size = static_cast<std::uint64_t> ( tree_.nodes.size ( ) );
+    std::vector<char> buffer;
+    buffer.insert ( buffer.end ( ), detail::packed_magic, detail::packed_magic + sizeof ( detail::packed_magic ) );
+    detail::put_varint ( buffer, payload.size ( ) );
+    detail::put_varint ( buffer, sizeof ( typename Tree::index_type ) );
+    detail::put_varint ( buffer, size );
+    out_.write ( buffer.data ( ), static_cast<std::streamsize> ( buffer.size ( ) ) );
+    std::vector<char> chunk;
+    for ( std::uint64_t begin = 0; begin < size; begin += detail::packed_chunk_size ) {
+        std::uint64_t const end = std::min<std::uint64_t> ( size, begin + detail::packed_chunk_size );
+        chunk.clear ( );
+        for ( std::uint64_t i = begin; i < end; ++i ) {
+            nid const n{ static_cast<typename Tree::index_type> ( i ) };
+            auto const & hook = tree_.hook ( n );
+            detail::put_varint ( chunk, detail::encode_link ( n, hook.up ) );
+            detail::put_varint ( chunk, detail::encode_link ( n, hook.prev ) );
+            detail::put_varint ( chunk, detail::encode_link ( n, hook.tail ) );
+            detail::put_varint ( chunk, static_cast<std::uint64_t> ( hook.fan ) );
+            payload.put ( chunk, tree_[ n ] );
+        }
+        buffer.clear ( );
+        detail::put_varint ( buffer, end - begin );
+        detail::put_varint ( buffer, chunk.size ( ) );
+        out_.write ( buffer.data ( ), static_cast<std::streamsize> ( buffer.size ( ) ) );
+        out_.write ( chunk.data ( ), static_cast<std::streamsize> ( chunk.size ( ) ) );
+    }
+    if ( not out_ )
+        throw std::runtime_error ( "rooted_tree: write failed" );
+}
+
+// Replaces the contents of tree_ with a tree read from in_ (opened in binary mode), written by write_packed ( ).
+// The nodes are decoded in place, chunk by chunk, not safe/concurrent. Throws std::runtime_error on a stream that
+// does not match the tree type (tree_ is unchanged then), or that is damaged, or does not hold a tree (tree_ is left
+// empty then).
+template<typename Tree>
+void read_packed ( Tree & tree_, std::istream & in_ ) {
+    using nid        = typename Tree::nid;
+    using index_type = typename Tree::index_type;
+    static_assert ( std::is_trivially_copyable<typename Tree::value_type>::value, "the payload must be trivially copyable" );
+    detail::packed_payload<Tree> const payload{ tree_ };
+    char magic[ sizeof ( detail::packed_magic ) ];
+    if ( not in_.read ( magic, sizeof ( magic ) ) or std::memcmp ( magic, detail::packed_magic, sizeof ( magic ) ) )
+        throw std::runtime_error ( "rooted_tree: not a packed tree" );
+    if ( detail::get_varint ( in_ ) != payload.size ( ) )
+        throw std::runtime_error ( "rooted_tree: node type mismatch" );
+    if ( detail::get_varint ( in_ ) != sizeof ( index_type ) )
+        throw std::runtime_error ( "rooted_tree: index type mismatch" );
+    std::uint64_t const size = detail::get_varint ( in_ );
+    if ( not size or size - 1 > static_cast<std::uint64_t> ( std::numeric_limits<index_type>::max ( ) ) )
+        throw std::runtime_error ( "rooted_tree: corrupt packed tree" );
+    tree_.clear ( );
+    tree_.reserve ( static_cast<typename Tree::size_type> ( size ) );
+    try {
+        std::vector<char> chunk;
+        for ( std::uint64_t begin = 0; begin < size; ) {
+            std::uint64_t const count = detail::get_varint ( in_ ), bytes = detail::get_varint ( in_ );
+            if ( not count or count > size - begin or bytes > count * ( 40 + payload.size ( ) ) )
+                throw std::runtime_error ( "rooted_tree: corrupt packed tree" );
+            chunk.resize ( static_cast<std::size_t> ( bytes ) );
+            if ( not in_.read ( chunk.data ( ), static_cast<std::streamsize> ( bytes ) ) )
+                throw std::runtime_error ( "rooted_tree: truncated packed tree" );
+            // The sentinel is there already.
+            std::uint64_t const grow = begin + count - static_cast<std::uint64_t> ( tree_.nodes.size ( ) );
+            if constexpr ( Tree::is_concurrent::value ) {
+                tree_.nodes.grow_by ( grow );
+                if constexpr ( Tree::is_split::value )
+                    tree_.hooks.grow_by ( grow );
+            }
+            else {
+                tree_.nodes.resize ( tree_.nodes.size ( ) + grow );
+                if constexpr ( Tree::is_split::value )
+                    tree_.hooks.resize ( tree_.hooks.size ( ) + grow );
+            }
+            char const *in = chunk.data ( ), *end = in + chunk.size ( );
+            for ( std::uint64_t i = begin; i < begin + count; ++i ) {
+                nid const n{ static_cast<index_type> ( i ) };
+                auto & hook = tree_.hook ( n );
+                hook.up     = detail::decode_link ( n, detail::get_varint ( in, end ), size );
+                hook.prev   = detail::decode_link ( n, detail::get_varint ( in, end ), size );
+                hook.tail   = detail::decode_link ( n, detail::get_varint ( in, end ), size );
+                std::uint64_t const fan = detail::get_varint ( in, end );
+                if ( fan >= size ) // Fits index_type.
+                    throw std::runtime_error ( "rooted_tree: corrupt packed tree" );
+                hook.fan = static_cast<index_type> ( fan );
+                payload.get ( in, end, tree_[ n ] );
+            }
+            if ( in != end )
+                throw std::runtime_error ( "rooted_tree: corrupt packed tree" );
+            begin += count;
+        }
+        if ( not detail::is_tree ( tree_, size ) )
+            throw std::runtime_error ( "rooted_tree: corrupt packed tree" );
+    }
+    catch ( ... ) {
+        tree_.clear ( ); // Not to leave links behind that could be walked in circles.
+        throw;
+    }
+    tree_.rebuild ( );
+}
+
+} // namespace sax
@@ -30,24 +30,30 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 
 #if USE_IO
 #    include <iostream>
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
-#if ( defined( __clang__ ) or defined( __GNUC__ ) ) and not defined( _MSC_VER )
-#    include <deque>
-#else
-#    include <boost/container/deque.hpp>
-#endif
-
+#include <tbb/blocked_range.h>
 #include <tbb/concurrent_vector.h> // tbb_config.h needs fixing to make this work with clang-cl.
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 #include <tbb/spin_mutex.h>
+#include <tbb/task_group.h>
 
 #if USE_CEREAL
 #    include <cereal/cereal.hpp>
@@ -58,25 +64,29 @@
 
 namespace sax {
 
-struct nid {
+// A node id, Index is the (signed or unsigned) integral type the nids (and the size of the tree) fit in.
+template<typename Index>
+struct basic_nid {
 
-    int id;
+    using index_type = Index;
 
-    nid ( ) noexcept {} // id uninitialized.
-    constexpr explicit nid ( int && value_ ) noexcept : id{ std::move ( value_ ) } {}
-    constexpr explicit nid ( int const & value_ ) noexcept : id{ value_ } {}
+    Index id;
 
-    [[nodiscard]] bool operator== ( nid const rhs_ ) const noexcept { return id == rhs_.id; }
-    [[nodiscard]] bool operator!= ( nid const rhs_ ) const noexcept { return id != rhs_.id; }
+    basic_nid ( ) noexcept {} // id uninitialized.
+    constexpr explicit basic_nid ( Index && value_ ) noexcept : id{ std::move ( value_ ) } {}
+    constexpr explicit basic_nid ( Index const & value_ ) noexcept : id{ value_ } {}
+
+    [[nodiscard]] bool operator== ( basic_nid const rhs_ ) const noexcept { return id == rhs_.id; }
+    [[nodiscard]] bool operator!= ( basic_nid const rhs_ ) const noexcept { return id != rhs_.id; }
 
     [[nodiscard]] bool is_valid ( ) const noexcept { return id; }
     [[nodiscard]] bool is_invalid ( ) const noexcept { return not is_valid ( ); }
 
-    [[nodiscard]] nid operator++ ( ) noexcept { return nid{ ++id }; }
-    [[nodiscard]] nid operator++ ( int ) noexcept { return nid{ id++ }; }
+    [[nodiscard]] basic_nid operator++ ( ) noexcept { return basic_nid{ ++id }; }
+    [[nodiscard]] basic_nid operator++ ( int ) noexcept { return basic_nid{ id++ }; }
 
     template<typename Stream>
-    [[maybe_unused]] friend Stream & operator<< ( Stream & out_, nid const id_ ) noexcept {
+    [[maybe_unused]] friend Stream & operator<< ( Stream & out_, basic_nid const id_ ) noexcept {
         if ( nid_invalid_v == id_.id ) {
             if constexpr ( std::is_same<typename Stream::char_type, wchar_t>::value ) {
                 out_ << L'*';
@@ -86,12 +96,12 @@ struct nid {
             }
         }
         else {
-            out_ << id_.id;
+            out_ << +id_.id;
         }
         return out_;
     }
 
-    static constexpr int nid_invalid_v = 0;
+    static constexpr Index nid_invalid_v = 0;
 
 #if USE_CEREAL
     private:
@@ -103,61 +113,60 @@ struct nid {
 #endif
 };
 
+using nid = basic_nid<int>;
+
 namespace detail {
 
 template<typename T>
 using zeroing_vector = std::vector<T, tbb::zero_allocator<T>>;
-using id_vector      = zeroing_vector<nid>;
-
-#if ( defined( __clang__ ) or defined( __GNUC__ ) ) and not defined( _MSC_VER )
-using id_deque = std::deque<nid, tbb::tbb_allocator<nid>>;
-#else
-using id_deque = boost::container::deque<nid, tbb::tbb_allocator<nid>>;
-#endif
-
-// De-queue.
-[[nodiscard]] nid de ( id_deque & deq_ ) noexcept {
-    assert ( deq_.size ( ) );
-    nid v = deq_.front ( );
-    deq_.pop_front ( );
-    return v;
-}
-
-// En-queue.
-template<typename T>
-[[maybe_unused]] auto en ( id_deque & deq_, T const & v_ ) {
-    return deq_.push_back ( v_ );
-}
+template<typename Nid>
+using basic_id_vector = zeroing_vector<Nid>;
+using id_vector       = basic_id_vector<nid>;
 
 // Pop stack.
-[[nodiscard]] nid pop ( id_vector & vec_ ) noexcept {
+template<typename Nid>
+[[nodiscard]] Nid pop ( basic_id_vector<Nid> & vec_ ) noexcept {
     assert ( vec_.size ( ) );
-    nid v = vec_.back ( );
+    Nid v = vec_.back ( );
     vec_.pop_back ( );
     return v;
 }
 
 // Push stack.
-template<typename T>
-[[maybe_unused]] auto push ( id_vector & vec_, T const & v_ ) {
+template<typename Nid, typename T>
+[[maybe_unused]] auto push ( basic_id_vector<Nid> & vec_, T const & v_ ) {
     return vec_.push_back ( v_ );
 }
 
 inline constexpr int reserve_size = 1'024;
 
+enum class node_order { depth_first, breadth_first, van_emde_boas };
+
+// Atomic access to a plain (hook-) member.
+template<typename T>
+[[nodiscard]] std::atomic<T> & as_atomic ( T & value_ ) noexcept {
+    static_assert ( sizeof ( std::atomic<T> ) == sizeof ( T ) and std::atomic<T>::is_always_lock_free, "T cannot be made atomic" );
+    return *reinterpret_cast<std::atomic<T> *> ( std::addressof ( value_ ) );
+}
+
 // Hooks.
 
-struct rooted_tree_hook { // 16 bytes.
-    nid up = nid{ 0 }, prev = nid{ 0 }, tail = nid{ 0 };
-    int fan = 0; // 0 <= fan-out < 2'147'483'648.
+// The index type of a hook determines the nid type (and size_type) of the tree, a custom hook (deriving from this
+// one) inherits it.
+template<typename Index>
+struct basic_rooted_tree_hook { // 4 * sizeof ( Index ) bytes.
+    using index_type = Index;
+
+    basic_nid<Index> up = basic_nid<Index>{ 0 }, prev = basic_nid<Index>{ 0 }, tail = basic_nid<Index>{ 0 };
+    Index fan = 0; // 0 <= fan-out <= the maximum of Index.
 
 #if USE_IO
     template<typename Stream>
-    [[maybe_unused]] friend Stream & operator<< ( Stream & out_, rooted_tree_hook const & nid_ ) noexcept {
+    [[maybe_unused]] friend Stream & operator<< ( Stream & out_, basic_rooted_tree_hook const & nid_ ) noexcept {
         if constexpr ( std::is_same<typename Stream::char_type, wchar_t>::value )
-            out_ << L'<' << nid_.up << L' ' << nid_.prev << L' ' << nid_.tail << L' ' << nid_.fan << L'>';
+            out_ << L'<' << nid_.up << L' ' << nid_.prev << L' ' << nid_.tail << L' ' << +nid_.fan << L'>';
         else
-            out_ << '<' << nid_.up << ' ' << nid_.prev << ' ' << nid_.tail << ' ' << nid_.fan << '>';
+            out_ << '<' << nid_.up << ' ' << nid_.prev << ' ' << nid_.tail << ' ' << +nid_.fan << '>';
         return out_;
     }
 #endif
@@ -172,25 +181,579 @@ struct rooted_tree_hook { // 16 bytes.
 #endif
 };
 
-template<typename Node>
-struct rooted_tree_node_mutex : public Node { // 2 bytes.
-    tbb::spin_mutex lock;
-    tbb::atomic<char> done = 1; // Indicates node is constructed (allocated with zeroed memory).
-    template<typename... Args>
-    rooted_tree_node_mutex ( Args &&... args_ ) : Node{ std::forward<Args> ( args_ )... } { };
+using rooted_tree_hook = basic_rooted_tree_hook<int>; // 16 bytes.
+
+// Opt-in, a hook with a depth member has it maintained on insertion (the root-node being at depth 0), and the
+// tree keeps track of the maximum depth, which makes height ( ) O(1).
+template<typename Index>
+struct basic_depth_hook : basic_rooted_tree_hook<Index> {
+    Index depth = 0;
+};
+
+using depth_hook = basic_depth_hook<int>; // 20 bytes.
+
+template<typename Hook, typename = void>
+struct has_depth : std::false_type {};
+template<typename Hook>
+struct has_depth<Hook, std::void_t<decltype ( std::declval<Hook &> ( ).depth )>> : std::true_type {};
+
+// Opt-in, a hook with a subtree_size member has it maintained, either eagerly, on every insertion and erasure,
+// by updating all ancestors, or lazily, by re-computing all sizes (in parallel) when a size is asked for after a
+// change.
+enum class size_policy { eager, lazy };
+
+template<typename Index, size_policy Policy>
+struct basic_size_hook : basic_rooted_tree_hook<Index> {
+    static constexpr size_policy subtree_size_policy = Policy;
+
+    Index subtree_size = 1; // The number of nodes in the sub-tree rooted at this node.
+};
+
+using eager_size_hook = basic_size_hook<int, size_policy::eager>; // 20 bytes.
+using lazy_size_hook  = basic_size_hook<int, size_policy::lazy>;  // 20 bytes.
+
+template<typename Hook, typename = void>
+struct has_subtree_size : std::false_type {};
+template<typename Hook>
+struct has_subtree_size<Hook, std::void_t<decltype ( std::declval<Hook &> ( ).subtree_size )>> : std::true_type {};
+
+template<typename Hook>
+[[nodiscard]] constexpr bool is_lazy_subtree_size ( ) noexcept {
+    if constexpr ( has_subtree_size<Hook>::value )
+        return size_policy::lazy == Hook::subtree_size_policy;
+    else
+        return false;
+}
+
+// Opt-in, a hook with an epoch member is stamped on insertion, with the tree's epoch at that time, which makes
+// snapshots possible, see rooted_tree_base::snapshot ( ).
+using epoch_type = std::uint32_t;
+
+template<typename Index>
+struct basic_epoch_hook : basic_rooted_tree_hook<Index> {
+    epoch_type epoch = 0;
+};
+
+using epoch_hook = basic_epoch_hook<int>; // 20 bytes.
+
+template<typename Hook, typename = void>
+struct has_epoch : std::false_type {};
+template<typename Hook>
+struct has_epoch<Hook, std::void_t<decltype ( std::declval<Hook &> ( ).epoch )>> : std::true_type {};
+
+// Writers in flight, per epoch parity, for a group of threads.
+struct alignas ( 64 ) epoch_writers {
+    std::atomic<int> count[ 2 ] = { 0, 0 };
+};
+
+inline constexpr int epoch_writers_size = 16;
+
+// A small per-thread number, to spread the threads over the epoch_writers.
+[[nodiscard]] inline int thread_stripe ( ) noexcept {
+    static std::atomic<int> next{ 0 };
+    thread_local int const stripe = next.fetch_add ( 1, std::memory_order_relaxed ) % epoch_writers_size;
+    return stripe;
+}
+
+// A stack of nids, with a small inline buffer, that only allocates when it outgrows it. Constructed from a
+// (caller supplied) scratch buffer, that buffer is used instead, which (keeping its capacity) can be re-used
+// over many traversals.
+template<typename Nid>
+class basic_id_stack {
+    public:
+    using id_vector = basic_id_vector<Nid>;
+
+    static constexpr int inline_size = 32;
+
+    basic_id_stack ( ) noexcept {}
+    explicit basic_id_stack ( id_vector & scratch_ ) noexcept : heap{ std::addressof ( scratch_ ) } { heap->clear ( ); }
+    basic_id_stack ( basic_id_stack const & o_ ) : count{ o_.count }, own{ o_.heap ? *o_.heap : id_vector{ } } {
+        std::copy ( o_.buffer, o_.buffer + o_.count, buffer );
+        heap = o_.heap ? std::addressof ( own ) : nullptr;
+    }
+    basic_id_stack & operator= ( basic_id_stack const & ) = delete;
+
+    [[nodiscard]] std::size_t size ( ) const noexcept { return heap ? heap->size ( ) : static_cast<std::size_t> ( count ); }
+
+    void push ( Nid value_ ) {
+        if ( heap ) {
+            heap->push_back ( value_ );
+        }
+        else if ( count < inline_size ) {
+            buffer[ count++ ] = value_;
+        }
+        else {
+            own.reserve ( 2 * inline_size );
+            own.assign ( buffer, buffer + count );
+            own.push_back ( value_ );
+            heap = std::addressof ( own );
+        }
+    }
+    [[nodiscard]] Nid pop ( ) noexcept {
+        assert ( size ( ) );
+        if ( heap ) {
+            Nid v = heap->back ( );
+            heap->pop_back ( );
+            return v;
+        }
+        return buffer[ --count ];
+    }
+
+    private:
+    Nid buffer[ inline_size ];
+    int count        = 0;
+    id_vector * heap = nullptr;
+    id_vector own;
+};
+
+// A fifo (ring-) queue of nids, with a small inline buffer, that only allocates when it outgrows it. Constructed
+// from a (caller supplied) scratch buffer, that buffer is used instead, which (keeping its size) can be re-used
+// over many traversals.
+template<typename Nid>
+class basic_id_ring {
+    public:
+    using id_vector = basic_id_vector<Nid>;
+
+    static constexpr std::size_t inline_size = 32;
+
+    basic_id_ring ( ) noexcept {}
+    explicit basic_id_ring ( id_vector & scratch_ ) : heap{ std::addressof ( scratch_ ) } {
+        std::size_t capacity = inline_size;
+        while ( capacity < heap->size ( ) )
+            capacity <<= 1;
+        heap->resize ( capacity );
+        mask = capacity - 1;
+    }
+    basic_id_ring ( basic_id_ring const & o_ ) :
+        own{ o_.heap ? *o_.heap : id_vector{ } }, head{ o_.head }, count{ o_.count }, mask{ o_.mask } {
+        std::copy ( o_.buffer, o_.buffer + inline_size, buffer );
+        heap = o_.heap ? std::addressof ( own ) : nullptr;
+    }
+    basic_id_ring & operator= ( basic_id_ring const & ) = delete;
+
+    [[nodiscard]] std::size_t size ( ) const noexcept { return count; }
+
+    void push ( Nid value_ ) {
+        if ( count == mask + 1 )
+            grow ( );
+        data ( )[ ( head + count++ ) & mask ] = value_;
+    }
+    [[nodiscard]] Nid pop ( ) noexcept {
+        assert ( count );
+        Nid v = data ( )[ head ];
+        head  = ( head + 1 ) & mask;
+        count -= 1;
+        return v;
+    }
+
+    private:
+    [[nodiscard]] Nid * data ( ) noexcept { return heap ? heap->data ( ) : buffer; }
+
+    void grow ( ) {
+        id_vector grown ( 2 * ( mask + 1 ) );
+        for ( std::size_t i = 0; i < count; ++i )
+            grown[ i ] = data ( )[ ( head + i ) & mask ];
+        if ( not heap )
+            heap = std::addressof ( own );
+        heap->swap ( grown );
+        head = 0;
+        mask = heap->size ( ) - 1;
+    }
+
+    Nid buffer[ inline_size ];
+    id_vector * heap = nullptr;
+    id_vector own;
+    std::size_t head = 0, count = 0, mask = inline_size - 1;
+};
+
+using id_stack = basic_id_stack<nid>;
+using id_ring  = basic_id_ring<nid>;
+
+// De-queue.
+template<typename Nid>
+[[nodiscard]] Nid de ( basic_id_ring<Nid> & queue_ ) noexcept { return queue_.pop ( ); }
+
+// En-queue.
+template<typename Nid>
+void en ( basic_id_ring<Nid> & queue_, Nid v_ ) { queue_.push ( v_ ); }
+
+// Pop stack.
+template<typename Nid>
+[[nodiscard]] Nid pop ( basic_id_stack<Nid> & stack_ ) noexcept { return stack_.pop ( ); }
+
+// Push stack.
+template<typename Nid>
+void push ( basic_id_stack<Nid> & stack_, Nid v_ ) { stack_.push ( v_ ); }
+
+// Iterators, Tree is a rooted_tree_base, or a const one (for the const_ iterators). The stack and queue based
+// iterators can be given a scratch buffer to use.
+
+template<typename Tree>
+using tree_reference_t = std::conditional_t<std::is_const<Tree>::value, typename Tree::const_reference, typename Tree::reference>;
+template<typename Tree>
+using tree_pointer_t = std::conditional_t<std::is_const<Tree>::value, typename Tree::const_pointer, typename Tree::pointer>;
+
+template<typename Tree>
+class basic_internal_iterator {
+    using nid       = typename Tree::nid;
+    using id_vector = basic_id_vector<nid>;
+
+    Tree & tree;
+    basic_id_stack<nid> stack;
+    nid node;
+
+    void init ( nid nid_ ) {
+        if ( tree.hook ( nid_ ).tail.is_valid ( ) ) {
+            node = nid_;
+            for ( nid child = tree.hook ( node ).tail; child.is_valid ( ); child = tree.hook ( child ).prev )
+                if ( tree.hook ( child ).tail.is_valid ( ) )
+                    push ( stack, child );
+        }
+        else {
+            node = Tree::invalid;
+        }
+    }
+
+    public:
+    basic_internal_iterator ( Tree & tree_, nid nid_ = Tree::root ) : tree{ tree_ } { init ( nid_ ); }
+    basic_internal_iterator ( Tree & tree_, id_vector & scratch_, nid nid_ = Tree::root ) : tree{ tree_ }, stack{ scratch_ } {
+        init ( nid_ );
+    }
+    [[maybe_unused]] basic_internal_iterator & operator++ ( ) {
+        if ( stack.size ( ) ) {
+            node = pop ( stack );
+            for ( nid child = tree.hook ( node ).tail; child.is_valid ( ); child = tree.hook ( child ).prev )
+                if ( tree.hook ( child ).tail.is_valid ( ) )
+                    push ( stack, child );
+            return *this;
+        }
+        else {
+            node = Tree::invalid;
+            return *this;
+        }
+    }
+    [[nodiscard]] tree_reference_t<Tree> operator* ( ) const noexcept { return tree[ node ]; }
+    [[nodiscard]] tree_pointer_t<Tree> operator-> ( ) const noexcept { return std::addressof ( tree[ node ] ); }
+    [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
+    [[nodiscard]] nid id ( ) const noexcept { return node; }
 };
 
-// The rooted tree has 1 root.
-template<typename Node, bool Concurrent = false>
+template<typename Tree>
+class basic_leaf_iterator {
+    using nid       = typename Tree::nid;
+    using id_vector = basic_id_vector<nid>;
+
+    Tree & tree;
+    basic_id_stack<nid> stack;
+    nid node;
+
+    void init ( nid nid_ ) {
+        for ( nid child = tree.hook ( nid_ ).tail; child.is_valid ( ); child = tree.hook ( child ).prev )
+            push ( stack, child );
+        if ( stack.size ( ) )
+            this->operator++ ( );
+        else
+            node = Tree::invalid;
+    }
+
+    public:
+    basic_leaf_iterator ( Tree & tree_, nid nid_ = Tree::root ) : tree{ tree_ } { init ( nid_ ); }
+    basic_leaf_iterator ( Tree & tree_, id_vector & scratch_, nid nid_ = Tree::root ) : tree{ tree_ }, stack{ scratch_ } {
+        init ( nid_ );
+    }
+    [[maybe_unused]] basic_leaf_iterator & operator++ ( ) {
+        while ( true ) {
+            if ( stack.size ( ) ) {
+                node = pop ( stack );
+                if ( tree.hook ( node ).tail.is_invalid ( ) )
+                    return *this;
+                for ( nid child = tree.hook ( node ).tail; child.is_valid ( ); child = tree.hook ( child ).prev )
+                    push ( stack, child );
+            }
+            else {
+                node = Tree::invalid;
+                return *this;
+            }
+        }
+    }
+    [[nodiscard]] tree_reference_t<Tree> operator* ( ) const noexcept { return tree[ node ]; }
+    [[nodiscard]] tree_pointer_t<Tree> operator-> ( ) const noexcept { return std::addressof ( tree[ node ] ); }
+    [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
+    [[nodiscard]] nid id ( ) const noexcept { return node; }
+};
+
+template<typename Tree>
+class basic_depth_iterator {
+    using nid       = typename Tree::nid;
+    using id_vector = basic_id_vector<nid>;
+
+    Tree & tree;
+    basic_id_stack<nid> stack;
+    nid node;
+
+    void init ( ) {
+        for ( nid child = tree.hook ( node ).tail; child.is_valid ( ); child = tree.hook ( child ).prev )
+            push ( stack, child );
+    }
+
+    public:
+    basic_depth_iterator ( Tree & tree_, nid nid_ = Tree::root ) : tree{ tree_ }, node{ nid_ } { init ( ); }
+    basic_depth_iterator ( Tree & tree_, id_vector & scratch_, nid nid_ = Tree::root ) :
+        tree{ tree_ }, stack{ scratch_ }, node{ nid_ } {
+        init ( );
+    }
+    [[maybe_unused]] basic_depth_iterator & operator++ ( ) {
+        if ( stack.size ( ) ) {
+            node = pop ( stack );
+            for ( nid child = tree.hook ( node ).tail; child.is_valid ( ); child = tree.hook ( child ).prev )
+                push ( stack, child );
+            return *this;
+        }
+        else {
+            node = Tree::invalid;
+            return *this;
+        }
+    }
+    [[nodiscard]] tree_reference_t<Tree> operator* ( ) const noexcept { return tree[ node ]; }
+    [[nodiscard]] tree_pointer_t<Tree> operator-> ( ) const noexcept { return std::addressof ( tree[ node ] ); }
+    [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
+    [[nodiscard]] nid id ( ) const noexcept { return node; }
+};
+
+// Pre-order, without a stack (O(1) memory), by following the up-links back. Children are visited in
+// out_iterator order.
+template<typename Tree>
+class basic_pre_order_iterator {
+    using nid = typename Tree::nid;
+
+    Tree & tree;
+    nid start, node;
+
+    public:
+    basic_pre_order_iterator ( Tree & tree_, nid nid_ = Tree::root ) noexcept : tree{ tree_ }, start{ nid_ }, node{ nid_ } {}
+    [[maybe_unused]] basic_pre_order_iterator & operator++ ( ) noexcept {
+        if ( nid tail = tree.hook ( node ).tail; tail.is_valid ( ) ) {
+            node = tail;
+            return *this;
+        }
+        while ( node != start ) {
+            if ( nid prev = tree.hook ( node ).prev; prev.is_valid ( ) ) {
+                node = prev;
+                return *this;
+            }
+            node = tree.hook ( node ).up;
+        }
+        node = Tree::invalid;
+        return *this;
+    }
+    [[nodiscard]] tree_reference_t<Tree> operator* ( ) const noexcept { return tree[ node ]; }
+    [[nodiscard]] tree_pointer_t<Tree> operator-> ( ) const noexcept { return std::addressof ( tree[ node ] ); }
+    [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
+    [[nodiscard]] nid id ( ) const noexcept { return node; }
+};
+
+// Post-order (children before their parent), without a stack (O(1) memory), by following the up-links back.
+// Children are visited in out_iterator order.
+template<typename Tree>
+class basic_post_order_iterator {
+    using nid = typename Tree::nid;
+
+    Tree & tree;
+    nid start, node;
+
+    [[nodiscard]] nid first_leaf ( nid nid_ ) const noexcept {
+        for ( nid tail = tree.hook ( nid_ ).tail; tail.is_valid ( ); tail = tree.hook ( nid_ ).tail )
+            nid_ = tail;
+        return nid_;
+    }
+
+    public:
+    basic_post_order_iterator ( Tree & tree_, nid nid_ = Tree::root ) noexcept :
+        tree{ tree_ }, start{ nid_ }, node{ first_leaf ( nid_ ) } {}
+    [[maybe_unused]] basic_post_order_iterator & operator++ ( ) noexcept {
+        if ( node == start )
+            node = Tree::invalid;
+        else if ( nid prev = tree.hook ( node ).prev; prev.is_valid ( ) )
+            node = first_leaf ( prev );
+        else
+            node = tree.hook ( node ).up;
+        return *this;
+    }
+    [[nodiscard]] tree_reference_t<Tree> operator* ( ) const noexcept { return tree[ node ]; }
+    [[nodiscard]] tree_pointer_t<Tree> operator-> ( ) const noexcept { return std::addressof ( tree[ node ] ); }
+    [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
+    [[nodiscard]] nid id ( ) const noexcept { return node; }
+};
+
+// It is safe to destroy the node the interator is pointing at.
+template<typename Tree>
+class basic_breadth_iterator {
+    using nid       = typename Tree::nid;
+    using id_vector = basic_id_vector<nid>;
+    using size_type = typename Tree::size_type;
+
+    Tree & tree;
+    basic_id_ring<nid> queue;
+    size_type max_depth, depth, count;
+    nid parent;
+
+    void init ( ) {
+        if ( ( not max_depth ) or ( max_depth > 1 ) )
+            for ( nid child = tree.hook ( parent ).tail; child.is_valid ( ); child = tree.hook ( child ).prev )
+                en ( queue, child );
+        count = static_cast<size_type> ( queue.size ( ) );
+        depth = 1 + static_cast<size_type> ( 0 != count );
+    }
+
+    public:
+    basic_breadth_iterator ( Tree & tree_, size_type max_depth_ = 0, nid nid_ = Tree::root ) :
+        tree{ tree_ }, max_depth{ max_depth_ }, parent{ nid_ } {
+        init ( );
+    }
+    basic_breadth_iterator ( Tree & tree_, id_vector & scratch_, size_type max_depth_ = 0, nid nid_ = Tree::root ) :
+        tree{ tree_ }, queue{ scratch_ }, max_depth{ max_depth_ }, parent{ nid_ } {
+        init ( );
+    }
+    [[maybe_unused]] basic_breadth_iterator & operator++ ( ) {
+        if ( size_type queue_size = static_cast<size_type> ( queue.size ( ) ); static_cast<bool> ( queue_size ) ) {
+            if ( not count ) {
+                count = queue_size;
+                if ( ( not max_depth ) or ( max_depth > 1 ) ) {
+                    if ( max_depth == depth++ ) {
+                        parent = Tree::invalid;
+                        return *this;
+                    }
+                }
+            }
+            parent = de ( queue );
+            count -= 1;
+            for ( nid child = tree.hook ( parent ).tail; child.is_valid ( ); child = tree.hook ( child ).prev )
+                en ( queue, child );
+            return *this;
+        }
+        else {
+            parent = Tree::invalid;
+            return *this;
+        }
+    }
+    [[nodiscard]] tree_reference_t<Tree> operator* ( ) const noexcept { return tree[ parent ]; }
+    [[nodiscard]] tree_pointer_t<Tree> operator-> ( ) const noexcept { return std::addressof ( tree[ parent ] ); }
+    [[nodiscard]] bool is_valid ( ) const noexcept { return parent.is_valid ( ); }
+    [[nodiscard]] nid id ( ) const noexcept { return parent; }
+    [[nodiscard]] size_type height ( ) const noexcept { return depth; }
+};
+
+template<typename Tree>
+class basic_out_iterator {
+    using nid = typename Tree::nid;
+
+    Tree & tree;
+    nid node;
+
+    public:
+    basic_out_iterator ( Tree & tree_, nid nid_ ) noexcept : tree{ tree_ }, node{ tree.hook ( nid_ ).tail } {}
+    [[maybe_unused]] basic_out_iterator & operator++ ( ) noexcept {
+        node = tree.hook ( node ).prev;
+        return *this;
+    }
+    [[nodiscard]] tree_reference_t<Tree> operator* ( ) const noexcept { return tree[ node ]; }
+    [[nodiscard]] tree_pointer_t<Tree> operator-> ( ) const noexcept { return std::addressof ( tree[ node ] ); }
+    [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
+    [[nodiscard]] nid id ( ) const noexcept { return node; }
+};
+
+template<typename Tree>
+class basic_up_iterator {
+    using nid = typename Tree::nid;
+
+    Tree & tree;
+    nid node;
+
+    public:
+    basic_up_iterator ( Tree & tree_, nid nid_ ) noexcept : tree{ tree_ }, node{ nid_ } {}
+    [[maybe_unused]] basic_up_iterator & operator++ ( ) noexcept {
+        node = tree.hook ( node ).up;
+        return *this;
+    }
+    [[nodiscard]] tree_reference_t<Tree> operator* ( ) const noexcept { return tree[ node ]; }
+    [[nodiscard]] tree_pointer_t<Tree> operator-> ( ) const noexcept { return std::addressof ( tree[ node ] ); }
+    [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
+    [[nodiscard]] nid id ( ) const noexcept { return node; }
+};
+
+template<typename Tree, typename Leaf, typename Combine, typename Out>
+void reduce_up_impl ( Tree & tree_, basic_id_vector<typename Tree::nid> const & roots_, Leaf & leaf_, Combine & combine_,
+                      Out & out_ );
+
+template<typename Tree>
+class basic_snapshot;
+
+// Whether the links of the first size_ hooks of tree_ (all of them inside [ 0, size_ )) form a tree: the sentinel
+// links (only) to the root-node, the nodes below it are reached once each, from the parent their up-link names, with
+// fans that match, all other nodes are unlinked. O(n), for the readers of untrusted files.
+template<typename Tree>
+[[nodiscard]] bool is_tree ( Tree const & tree_, std::uint64_t size_ ) {
+    using nid        = typename Tree::nid;
+    auto const & top = tree_.hook ( Tree::invalid );
+    bool const empty = size_ <= static_cast<std::uint64_t> ( Tree::root.id );
+    if ( top.up.is_valid ( ) or top.prev.is_valid ( ) or top.tail != ( empty ? Tree::invalid : Tree::root ) or
+         static_cast<std::uint64_t> ( top.fan ) != ( empty ? 0u : 1u ) )
+        return false;
+    if ( empty )
+        return true;
+    if ( tree_.hook ( Tree::root ).up.is_valid ( ) or tree_.hook ( Tree::root ).prev.is_valid ( ) )
+        return false;
+    std::vector<bool> reached ( static_cast<std::size_t> ( size_ ) );
+    std::vector<nid> stack ( 1, Tree::root );
+    reached[ static_cast<std::size_t> ( Tree::root.id ) ] = true;
+    while ( stack.size ( ) ) {
+        nid const parent = stack.back ( );
+        stack.pop_back ( );
+        std::uint64_t fan = 0;
+        for ( nid child = tree_.hook ( parent ).tail; child.is_valid ( ); child = tree_.hook ( child ).prev, ++fan ) {
+            if ( reached[ static_cast<std::size_t> ( child.id ) ] or parent != tree_.hook ( child ).up )
+                return false;
+            reached[ static_cast<std::size_t> ( child.id ) ] = true;
+            stack.push_back ( child );
+        }
+        if ( static_cast<std::uint64_t> ( tree_.hook ( parent ).fan ) != fan )
+            return false;
+    }
+    for ( std::uint64_t i = static_cast<std::uint64_t> ( Tree::root.id ) + 1; i < size_; ++i ) {
+        auto const & hook = tree_.hook ( nid{ static_cast<typename Tree::index_type> ( i ) } );
+        if ( not reached[ static_cast<std::size_t> ( i ) ] and
+             ( hook.up.is_valid ( ) or hook.prev.is_valid ( ) or hook.tail.is_valid ( ) ) )
+            return false;
+    }
+    return true;
+}
+
+// The rooted tree has 1 root. If Node does not derive from Hook, the hooks are stored in their own array (in
+// parallel to the payloads), so that traversals only touch the hooks. The concurrent tree constructs a payload
+// without touching its hook (other threads may be reading it), a Node that derives from Hook is therefore copied in
+// around it, and must be trivially copyable.
+template<typename Node, bool Concurrent = false, typename Hook = rooted_tree_hook>
 struct rooted_tree_base {
 
     using is_concurrent = std::integral_constant<bool, Concurrent>;
+    using is_split      = std::integral_constant<bool, not std::is_base_of<Hook, Node>::value>;
+    using has_depth     = detail::has_depth<Hook>;
+
+    using has_subtree_size      = detail::has_subtree_size<Hook>;
+    using has_lazy_subtree_size = std::integral_constant<bool, detail::is_lazy_subtree_size<Hook> ( )>;
+    using has_epoch             = detail::has_epoch<Hook>;
 
-    using value_type = std::conditional_t<is_concurrent::value, rooted_tree_node_mutex<Node>, Node>;
+    using value_type = Node;
+    using hook_type  = Hook;
+    using index_type = typename Hook::index_type;
+    using nid        = basic_nid<index_type>;
+    using id_vector  = basic_id_vector<nid>;
 
     private:
-    using data = std::conditional_t<is_concurrent::value, tbb::concurrent_vector<value_type, tbb::zero_allocator<value_type>>,
-                                    std::vector<value_type>>;
+    template<typename T>
+    using storage = std::conditional_t<is_concurrent::value, tbb::concurrent_vector<T, tbb::zero_allocator<T>>, std::vector<T>>;
+
+    using data = storage<value_type>;
 
     struct dummy_mutex final {
         dummy_mutex ( ) noexcept                = default;
@@ -205,6 +768,8 @@ struct rooted_tree_base {
         void unlock ( ) noexcept { return; };
     };
 
+    struct dummy_member final {};
+
     struct dummy_scoped_lock final {
         dummy_scoped_lock ( ) noexcept                      = delete;
         dummy_scoped_lock ( dummy_scoped_lock const & )     = delete;
@@ -219,8 +784,8 @@ struct rooted_tree_base {
     public:
     using mutex           = std::conditional_t<is_concurrent::value, tbb::spin_mutex, dummy_mutex>;
     using scoped_lock     = std::conditional_t<is_concurrent::value, tbb::spin_mutex::scoped_lock, dummy_scoped_lock>;
-    using size_type       = int;
-    using difference_type = int;
+    using size_type       = index_type;
+    using difference_type = std::make_signed_t<index_type>;
     using reference       = typename data::reference;
     using pointer         = typename data::pointer;
     using iterator        = typename data::iterator;
@@ -228,12 +793,14 @@ struct rooted_tree_base {
     using const_pointer   = typename data::const_pointer;
     using const_iterator  = typename data::const_iterator;
 
+    // Number of nids a thread reserves at once (concurrent only).
+    static constexpr size_type thread_reserve_size = 32;
+    // Number of nodes below which parallel algorithms don't split work.
+    static constexpr size_type grain_size = 4'096;
+
     rooted_tree_base ( ) {
-        nodes.reserve ( reserve_size );
-        if constexpr ( is_concurrent::value )
-            nodes.grow_by ( 1 );
-        else
-            nodes.emplace_back ( );
+        reserve ( reserve_size );
+        emplace_sentinel ( );
     }
 
     template<typename... Args>
@@ -252,509 +819,959 @@ struct rooted_tree_base {
     [[nodiscard]] value_type & operator[] ( size_type nid_ ) noexcept { return nodes[ nid_ ]; }
     [[nodiscard]] value_type const & operator[] ( size_type nid_ ) const noexcept { return nodes[ nid_ ]; }
 
+    [[nodiscard]] hook_type & hook ( nid nid_ ) noexcept {
+        if constexpr ( is_split::value )
+            return hooks[ nid_.id ];
+        else
+            return nodes[ nid_.id ];
+    }
+    [[nodiscard]] hook_type const & hook ( nid nid_ ) const noexcept {
+        if constexpr ( is_split::value )
+            return hooks[ nid_.id ];
+        else
+            return nodes[ nid_.id ];
+    }
+
     // Not safe/concurrent.
-    void reserve ( size_type c_ ) { nodes.reserve ( c_ ); }
-    // Not safe/concurrent.
-    void clear ( ) { nodes.clear ( ); }
+    void reserve ( size_type c_ ) {
+        nodes.reserve ( c_ );
+        if constexpr ( is_split::value )
+            hooks.reserve ( c_ );
+    }
+    // Not safe/concurrent. Removes all nodes, but the sentinel, a new root-node can be added after.
+    void clear ( ) {
+        nodes.clear ( );
+        if constexpr ( is_split::value )
+            hooks.clear ( );
+        emplace_sentinel ( );
+        free_list.clear ( );
+        if constexpr ( is_concurrent::value ) {
+            thread_local_data.clear ( );
+            free_list_end = 0;
+        }
+        if constexpr ( has_depth::value )
+            max_depth = 0;
+        if constexpr ( has_lazy_subtree_size::value )
+            subtree_sizes_dirty = false;
+    }
     // Not safe/concurrent.
-    void swap ( rooted_tree_base & rhs_ ) noexcept { nodes.swap ( rhs_.nodes ); }
+    void swap ( rooted_tree_base & rhs_ ) {
+        collect_reservations ( );
+        rhs_.collect_reservations ( );
+        nodes.swap ( rhs_.nodes );
+        if constexpr ( is_split::value )
+            hooks.swap ( rhs_.hooks );
+        free_list.swap ( rhs_.free_list );
+        if constexpr ( is_concurrent::value ) {
+            free_list_end = static_cast<size_type> ( free_list.size ( ) );
+            rhs_.free_list_end = static_cast<size_type> ( rhs_.free_list.size ( ) );
+            publish_all ( );
+            rhs_.publish_all ( );
+        }
+        if constexpr ( has_depth::value ) {
+            size_type const depth = max_depth;
+            max_depth             = static_cast<size_type> ( rhs_.max_depth );
+            rhs_.max_depth        = depth;
+        }
+        if constexpr ( has_lazy_subtree_size::value ) {
+            bool const dirty         = subtree_sizes_dirty;
+            subtree_sizes_dirty      = static_cast<bool> ( rhs_.subtree_sizes_dirty );
+            rhs_.subtree_sizes_dirty = dirty;
+        }
+    }
+
+    // Not safe/concurrent. Unlinks the sub-tree rooted at nid_ from its parent, its nids are recycled by later
+    // insertions. The root-node cannot be erased, use clear ( ) for that.
+    void erase_subtree ( nid nid_ ) {
+        assert ( nid_.is_valid ( ) and root != nid_ );
+        collect_reservations ( );
+        hook_type & parent = hook ( hook ( nid_ ).up );
+        nid * link         = std::addressof ( parent.tail );
+        while ( *link != nid_ )
+            link = std::addressof ( hook ( *link ).prev );
+        *link = hook ( nid_ ).prev;
+        parent.fan -= 1;
+        if constexpr ( has_subtree_size::value ) {
+            if constexpr ( has_lazy_subtree_size::value ) {
+                subtree_sizes_dirty = true;
+            }
+            else {
+                size_type const size = hook ( nid_ ).subtree_size;
+                for ( nid node = hook ( nid_ ).up; node.is_valid ( ); node = hook ( node ).up )
+                    hook ( node ).subtree_size -= size;
+            }
+        }
+        id_vector stack ( 1, nid_ );
+        [[maybe_unused]] bool deepest = false;
+        while ( stack.size ( ) ) {
+            nid node = pop ( stack );
+            for ( nid child = hook ( node ).tail; child.is_valid ( ); child = hook ( child ).prev )
+                push ( stack, child );
+            if constexpr ( has_depth::value )
+                deepest = deepest or max_depth == hook ( node ).depth;
+            construct ( node ); // Destroys the payload.
+            reset_hook ( node );
+            push ( free_list, node );
+        }
+        if constexpr ( is_concurrent::value )
+            free_list_end = static_cast<size_type> ( free_list.size ( ) );
+        if constexpr ( has_depth::value )
+            if ( deepest )
+                update_max_depth ( );
+    }
+
+    // Not safe/concurrent. Restores what derives from the links, after the nodes (and hooks) were filled in
+    // directly, f.e. by a reader: all unlinked nodes (but the sentinel and the root-node) are recycled, and the
+    // depths are set.
+    void rebuild ( ) {
+        free_list.clear ( );
+        for ( size_type i = static_cast<size_type> ( nodes.size ( ) ) - 1; i > root.id; --i )
+            if ( hook ( nid{ i } ).up.is_invalid ( ) )
+                push ( free_list, nid{ i } );
+        if constexpr ( is_concurrent::value ) {
+            thread_local_data.clear ( );
+            free_list_end = static_cast<size_type> ( free_list.size ( ) );
+            publish_all ( );
+        }
+        if constexpr ( has_depth::value ) {
+            if ( nodes.size ( ) > static_cast<std::size_t> ( root.id ) ) // Not an empty tree.
+                for ( pre_order_iterator it{ *this }; it.is_valid ( ); ++it ) {
+                    nid const up             = hook ( it.id ( ) ).up;
+                    hook ( it.id ( ) ).depth = up.is_valid ( ) ? static_cast<size_type> ( hook ( up ).depth + 1 ) : 0;
+                }
+            update_max_depth ( );
+        }
+        if constexpr ( has_subtree_size::value )
+            update_subtree_sizes ( );
+    }
+
+    // The number of nodes in the sub-tree rooted at nid_ (has_subtree_size only). If lazy, the first call after a
+    // change re-computes all sizes (not safe/concurrent).
+    [[nodiscard]] size_type subtree_size ( nid nid_ ) {
+        if constexpr ( has_lazy_subtree_size::value )
+            if ( subtree_sizes_dirty )
+                update_subtree_sizes ( );
+        return hook ( nid_ ).subtree_size;
+    }
+    // Not safe/concurrent. Re-computes the sizes of all sub-trees, bottom-up, in parallel (has_subtree_size only).
+    void update_subtree_sizes ( ) {
+        if ( nodes.size ( ) > static_cast<std::size_t> ( root.id ) ) {
+            auto one  = [] ( value_type const & ) { return size_type{ 1 }; };
+            auto plus = [] ( size_type a_, size_type b_ ) { return static_cast<size_type> ( a_ + b_ ); };
+            subtree_sizes sizes{ *this };
+            reduce_up_impl ( *this, id_vector ( 1, root ), one, plus, sizes );
+        }
+        if constexpr ( has_lazy_subtree_size::value )
+            subtree_sizes_dirty = false;
+    }
+
+    // Not safe/concurrent. Keeps only the sub-tree rooted at nid_, which becomes the root-node, in new densely
+    // packed storage. Returns the old to new nid mapping, nodes that were dropped map to invalid.
+    [[maybe_unused]] id_vector reroot ( nid nid_ ) {
+        assert ( nid_.is_valid ( ) );
+        return compact ( depth_first_order ( nid_ ) );
+    }
+
+    // Not safe/concurrent. Permutes the nodes into depth-first, breadth-first or van Emde Boas order, such that
+    // the matching traversal walks memory (mostly) sequentially. Returns the old to new nid mapping.
+    [[maybe_unused]] id_vector relayout ( node_order order_ ) {
+        switch ( order_ ) {
+            case node_order::depth_first: return compact ( depth_first_order ( root ) );
+            case node_order::breadth_first: return compact ( breadth_first_order ( root ) );
+            default: return compact ( van_emde_boas_order ( root ) );
+        }
+    }
+
+    // Pins the current epoch (has_epoch only), a snapshot shows the tree as it was at that moment, nodes inserted
+    // later are invisible to it. Safe/concurrent, writers continue while (the rare) pinning waits for the
+    // insertions of the pinned epoch, that are in flight, to finish.
+    using snapshot_type = basic_snapshot<rooted_tree_base>;
+
+    [[nodiscard]] snapshot_type snapshot ( ) {
+        if constexpr ( is_concurrent::value ) {
+            scoped_lock lock ( snapshot_mutex );
+            epoch_type const pinned = epoch.fetch_add ( 1 );
+            for ( epoch_writers & writers : epoch_writers_data )
+                while ( writers.count[ pinned & 1 ].load ( std::memory_order_acquire ) )
+                    std::this_thread::yield ( );
+            return { *this, pinned };
+        }
+        else {
+            return { *this, epoch++ };
+        }
+    }
 
     template<typename This = is_concurrent>
     std::enable_if_t<This::value> lock ( ) noexcept {
-        nodes[ invalid.id ].lock.lock ( );
+        tree_mutex.lock ( );
     };
     template<typename This = is_concurrent>
     [[nodiscard]] std::enable_if_t<This::value, bool> try_lock ( ) noexcept {
-        return nodes[ invalid.id ].lock.try_lock ( );
+        return tree_mutex.try_lock ( );
     };
     template<typename This = is_concurrent>
     std::enable_if_t<This::value> unlock ( ) noexcept {
-        nodes[ invalid.id ].lock.unlock ( );
+        tree_mutex.unlock ( );
     };
 
-    // Add a child (-node) to a parent. Add root-node by passing 'invalid' as parameter to pid_.
-    [[maybe_unused]] nid insert ( nid pid_, value_type && node_ ) noexcept {
-        if constexpr ( is_concurrent::value ) {
-            iterator cnode;
-            nid cid;
-            {
-                scoped_lock lock ( nodes[ invalid.id ].lock );
-                cnode = nodes.push_back ( std::move ( node_ ) );
-                cid   = nid{ static_cast<size_type> ( std::distance ( begin ( ), cnode ) ) };
-            }
-            return insert_impl ( pid_, cnode, cid );
-        }
-        else {
-            return insert_impl ( pid_, nodes.push_back ( std::move ( node_ ) ), nid{ static_cast<size_type> ( nodes.size ( ) ) } );
-        }
+    // Safe/concurrent. The nids below it are published, their slots are constructed, which makes them safe to probe
+    // with is_linked ( ). nodes.size ( ) (of the concurrent tree) also counts the slots still being constructed.
+    [[nodiscard]] size_type published_size ( ) const noexcept {
+        if constexpr ( is_concurrent::value )
+            return published.load ( std::memory_order_acquire );
+        else
+            return static_cast<size_type> ( nodes.size ( ) );
+    }
+
+    // Safe/concurrent. Whether nid_ (below published_size ( )) is a node of the tree, and not a slot reserved by a
+    // thread (or recycled), only a linked node is a valid parent (of the concurrent tree) to a thread that didn't
+    // insert it.
+    [[nodiscard]] bool is_linked ( nid nid_ ) const noexcept {
+        nid & up   = const_cast<nid &> ( hook ( nid_ ).up );
+        nid & top  = const_cast<nid &> ( hook ( invalid ).tail ); // the root-node.
+        if constexpr ( is_concurrent::value )
+            return as_atomic ( up ).load ( std::memory_order_acquire ).is_valid ( ) or
+                   ( nid_.is_valid ( ) and as_atomic ( top ).load ( std::memory_order_acquire ) == nid_ );
+        else
+            return up.is_valid ( ) or ( nid_.is_valid ( ) and top == nid_ );
     }
+
+    // Add a child (-node) to a parent. Add root-node by passing 'invalid' as parameter to pid_.
+    [[maybe_unused]] nid insert ( nid pid_, value_type && node_ ) { return emplace ( pid_, std::move ( node_ ) ); }
     // Add a child (-node) to a parent. Add root-node by passing 'invalid' as parameter to pid_.
-    [[maybe_unused]] nid insert ( nid pid_, value_type const & node_ ) noexcept {
+    [[maybe_unused]] nid insert ( nid pid_, value_type const & node_ ) { return emplace ( pid_, node_ ); }
+
+    // Add a child (-node) to a parent. Add root-node by passing 'invalid' as parameter to pid_. Throws
+    // std::length_error once the nids (of index_type) run out, the tree is unchanged then.
+    template<typename... Args>
+    [[maybe_unused]] nid emplace ( nid pid_, Args &&... args_ ) {
         if constexpr ( is_concurrent::value ) {
-            iterator cnode;
-            nid cid;
-            {
-                scoped_lock lock ( nodes[ invalid.id ].lock );
-                cnode = nodes.push_back ( node_ );
-                cid   = nid{ static_cast<size_type> ( std::distance ( begin ( ), cnode ) ) };
-            }
-            return insert_impl ( pid_, cnode, cid );
+            nid cid = reserve_nid ( );
+            construct ( cid, std::forward<Args> ( args_ )... );
+            return insert_impl ( pid_, cid );
         }
         else {
-            return insert_impl ( pid_, nodes.push_back ( node_ ), nid{ static_cast<size_type> ( nodes.size ( ) ) } );
+            if ( free_list.size ( ) ) {
+                nid cid = pop ( free_list );
+                construct ( cid, std::forward<Args> ( args_ )... );
+                return insert_impl ( pid_, cid );
+            }
+            check_nids ( nodes.size ( ) );
+            nid cid = nid{ static_cast<size_type> ( nodes.size ( ) ) };
+            nodes.emplace_back ( std::forward<Args> ( args_ )... );
+            if constexpr ( is_split::value )
+                hooks.emplace_back ( );
+            return insert_impl ( pid_, cid );
         }
     }
 
-    // Add a child (-node) to a parent. Add root-node by passing 'invalid' as parameter to pid_.
-    template<typename... Args>
-    [[maybe_unused]] nid emplace ( nid pid_, Args &&... args_ ) noexcept {
+    using internal_iterator         = basic_internal_iterator<rooted_tree_base>;
+    using const_internal_iterator   = basic_internal_iterator<rooted_tree_base const>;
+    using leaf_iterator             = basic_leaf_iterator<rooted_tree_base>;
+    using const_leaf_iterator       = basic_leaf_iterator<rooted_tree_base const>;
+    using depth_iterator            = basic_depth_iterator<rooted_tree_base>;
+    using const_depth_iterator      = basic_depth_iterator<rooted_tree_base const>;
+    using pre_order_iterator        = basic_pre_order_iterator<rooted_tree_base>;
+    using const_pre_order_iterator  = basic_pre_order_iterator<rooted_tree_base const>;
+    using post_order_iterator       = basic_post_order_iterator<rooted_tree_base>;
+    using const_post_order_iterator = basic_post_order_iterator<rooted_tree_base const>;
+    using breadth_iterator          = basic_breadth_iterator<rooted_tree_base>;
+    using const_breadth_iterator    = basic_breadth_iterator<rooted_tree_base const>;
+    using out_iterator              = basic_out_iterator<rooted_tree_base>;
+    using const_out_iterator        = basic_out_iterator<rooted_tree_base const>;
+    using up_iterator               = basic_up_iterator<rooted_tree_base>;
+    using const_up_iterator         = basic_up_iterator<rooted_tree_base const>;
+
+    // The (maximum) depth (or height) is the number of nodes along the longest path from the (by default
+    // root-node) node down to the farthest leaf node. It returns (optionally) the width_ through an out-pointer.
+    // O(1) for the root-node, without width_, if the hooks have a depth.
+    [[nodiscard]] size_type height ( nid rid_ = root, size_type * width_ = nullptr ) const {
+        if constexpr ( has_depth::value )
+            if ( root == rid_ and not width_ )
+                return static_cast<size_type> ( max_depth + 1 );
+        size_type max_width = 0, depth = 0;
+        for_each_level ( rid_, [ & ] ( size_type width ) {
+            if ( depth++ and width > max_width )
+                max_width = width;
+        } );
+        if ( width_ )
+            *width_ = max_width;
+        return depth;
+    }
+    // As above, returning the width of every level (the number of nodes at that depth below rid_, rid_ being
+    // level 0) in widths_.
+    [[maybe_unused]] size_type height ( nid rid_, std::vector<size_type> & widths_ ) const {
+        widths_.clear ( );
+        for_each_level ( rid_, [ & ] ( size_type width ) { widths_.push_back ( width ); } );
+        return static_cast<size_type> ( widths_.size ( ) );
+    }
+
+    data nodes;
+    std::conditional_t<is_split::value, storage<hook_type>, dummy_member> hooks;
+
+    static constexpr nid invalid = nid{ 0 }, root = nid{ 1 };
+
+    private:
+    // Nids reserved by a thread, a block of new nids and a claimed range of the free list.
+    struct reservation {
+        size_type begin = 0, end = 0, recycled_begin = 0, recycled_end = 0;
+    };
+
+    using thread_local_data_type =
+        std::conditional_t<is_concurrent::value,
+                           tbb::enumerable_thread_specific<reservation, tbb::cache_aligned_allocator<reservation>,
+                                                           tbb::ets_key_per_instance>,
+                           dummy_member>;
+
+    // Reserved, but not yet used, nodes are default constructed and unlinked, published_size ( ) is therefore an
+    // upper bound on the number of nodes in the tree, is_linked ( ) tells them apart.
+    thread_local_data_type thread_local_data;
+
+    std::conditional_t<is_concurrent::value, mutex, dummy_member> tree_mutex;
+    // Orders the blocks reserved, which makes the published nids contiguous, and keeps them at the same nids in nodes
+    // and hooks (concurrent only).
+    std::conditional_t<is_concurrent::value, mutex, dummy_member> reserve_mutex;
+    // The number of constructed slots, see published_size ( ) (concurrent only).
+    std::conditional_t<is_concurrent::value, std::atomic<size_type>, dummy_member> published{ };
+
+    // Recycled nids, the concurrent tree claims ranges from the back of [ 0, free_list_end ).
+    id_vector free_list;
+    std::conditional_t<is_concurrent::value, std::atomic<size_type>, dummy_member> free_list_end{ };
+
+    using max_depth_type = std::conditional_t<is_concurrent::value, std::atomic<size_type>, size_type>;
+    // The depth of the deepest node (has_depth only).
+    std::conditional_t<has_depth::value, max_depth_type, dummy_member> max_depth{ };
+
+    using dirty_type = std::conditional_t<is_concurrent::value, std::atomic<bool>, bool>;
+    // Set by a change of the tree, cleared by re-computing the sizes (lazy has_subtree_size only).
+    std::conditional_t<has_lazy_subtree_size::value, dirty_type, dummy_member> subtree_sizes_dirty{ };
+
+    using epoch_counter_type = std::conditional_t<is_concurrent::value, std::atomic<epoch_type>, epoch_type>;
+    // Stamps inserted nodes, every pin moves it on (has_epoch only).
+    std::conditional_t<has_epoch::value, epoch_counter_type, dummy_member> epoch{ };
+    // The insertions in flight, and serializes the pins, which makes a pin only wait for its own epoch (concurrent
+    // has_epoch only).
+    using epoch_writers_type = epoch_writers[ epoch_writers_size ];
+    std::conditional_t<is_concurrent::value and has_epoch::value, epoch_writers_type, dummy_member> epoch_writers_data;
+    std::conditional_t<is_concurrent::value and has_epoch::value, mutex, dummy_member> snapshot_mutex;
+
+    // The sub-tree sizes in the hooks, as an array (indexed by nid), for reduce_up_impl.
+    struct subtree_sizes {
+        rooted_tree_base & tree;
+        [[nodiscard]] size_type & operator[] ( size_type nid_ ) noexcept { return tree.hook ( nid{ nid_ } ).subtree_size; }
+    };
+
+    void emplace_sentinel ( ) {
         if constexpr ( is_concurrent::value ) {
-            iterator cnode;
-            nid cid;
-            {
-                scoped_lock lock ( nodes[ invalid.id ].lock );
-                cnode = nodes.emplace_back ( std::forward<Args> ( args_ )... );
-                cid   = nid{ static_cast<size_type> ( std::distance ( begin ( ), cnode ) ) };
-            }
-            return insert_impl ( pid_, cnode, cid );
+            nodes.grow_by ( 1 );
+            if constexpr ( is_split::value )
+                hooks.grow_by ( 1 );
+            publish_all ( );
         }
         else {
-            return insert_impl ( pid_, nodes.emplace_back ( std::forward<Args> ( args_ )... ),
-                                 nid{ static_cast<size_type> ( nodes.size ( ) ) } );
+            nodes.emplace_back ( );
+            if constexpr ( is_split::value )
+                hooks.emplace_back ( );
         }
     }
 
-    class internal_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base & tree;
-        id_vector stack;
-        nid node;
-
-        public:
-        internal_iterator ( rooted_tree_base & tree_, nid nid_ = rooted_tree_base::root ) : tree{ tree_ } {
-            if ( tree[ nid_.id ].fan ) {
-                node = nid_;
-                for ( nid child = tree[ node.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                    if ( tree[ child.id ].fan )
-                        push ( stack, child );
-            }
-            else {
-                node = rooted_tree_base::invalid;
-            }
+    [[nodiscard]] nid reserve_nid ( ) {
+        reservation & r = thread_local_data.local ( );
+        if ( r.recycled_begin != r.recycled_end )
+            return free_list[ --r.recycled_end ];
+        if ( r.begin == r.end ) {
+            if ( claim_recycled ( r ) )
+                return free_list[ --r.recycled_end ];
+            scoped_lock lock ( reserve_mutex );
+            check_nids ( nodes.size ( ) + thread_reserve_size ); // Also r.end has to fit.
+            r.begin = static_cast<size_type> ( std::distance ( nodes.begin ( ), nodes.grow_by ( thread_reserve_size ) ) );
+            if constexpr ( is_split::value )
+                hooks.grow_by ( thread_reserve_size );
+            r.end = r.begin + thread_reserve_size;
+            published.store ( r.end, std::memory_order_release ); // grow_by has constructed the block.
         }
-        [[maybe_unused]] internal_iterator & operator++ ( ) {
-            if ( stack.size ( ) ) {
-                node = pop ( stack );
-                for ( nid child = tree[ node.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                    if ( tree[ child.id ].fan )
-                        push ( stack, child );
-                return *this;
-            }
-            else {
-                node = rooted_tree_base::invalid;
-                return *this;
+        return nid{ r.begin++ };
+    }
+
+    // Throws if nid_ does not fit index_type, a wrapped nid would alias an existing node.
+    static void check_nids ( std::size_t nid_ ) {
+        if ( nid_ > static_cast<std::size_t> ( std::numeric_limits<index_type>::max ( ) ) )
+            throw std::length_error ( "rooted_tree: out of nids" );
+    }
+
+    // Not safe/concurrent. All slots are constructed.
+    void publish_all ( ) noexcept { published.store ( static_cast<size_type> ( nodes.size ( ) ), std::memory_order_release ); }
+
+    [[nodiscard]] bool claim_recycled ( reservation & r_ ) noexcept {
+        size_type end = free_list_end.load ( std::memory_order_relaxed ), begin;
+        do {
+            if ( not end )
+                return false;
+            begin = end > thread_reserve_size ? end - thread_reserve_size : 0;
+        } while ( not free_list_end.compare_exchange_weak ( end, begin, std::memory_order_relaxed ) );
+        r_.recycled_begin = begin;
+        r_.recycled_end   = end;
+        return true;
+    }
+
+    // Returns the nids reserved, but not used, by all threads to the free list.
+    void collect_reservations ( ) {
+        if constexpr ( is_concurrent::value ) {
+            id_vector unused;
+            for ( reservation & r : thread_local_data ) {
+                unused.insert ( unused.end ( ), free_list.begin ( ) + r.recycled_begin, free_list.begin ( ) + r.recycled_end );
+                for ( size_type i = r.begin; i < r.end; ++i )
+                    push ( unused, nid{ i } );
             }
+            thread_local_data.clear ( );
+            free_list.resize ( free_list_end );
+            free_list.insert ( free_list.end ( ), unused.begin ( ), unused.end ( ) );
+            free_list_end = static_cast<size_type> ( free_list.size ( ) );
         }
-        [[nodiscard]] reference operator* ( ) const noexcept { return tree[ node.id ]; }
-        [[nodiscard]] pointer operator-> ( ) const noexcept { return std::addressof ( tree[ node.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return node; }
-    };
+    }
 
-    class const_internal_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base const & tree;
-        id_vector stack;
-        nid node;
-
-        public:
-        const_internal_iterator ( rooted_tree_base const & tree_, nid nid_ = rooted_tree_base::root ) : tree{ tree_ } {
-            if ( tree[ nid_.id ].fan ) {
-                node = nid_;
-                for ( nid child = tree[ node.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                    if ( tree[ child.id ].fan )
-                        push ( stack, child );
-            }
-            else {
-                node = rooted_tree_base::invalid;
-            }
+    void raise_max_depth ( size_type depth_ ) noexcept {
+        if constexpr ( is_concurrent::value ) {
+            size_type max = max_depth.load ( std::memory_order_relaxed );
+            while ( max < depth_ and not max_depth.compare_exchange_weak ( max, depth_, std::memory_order_relaxed ) )
+                ;
         }
-        [[maybe_unused]] const_internal_iterator & operator++ ( ) {
-            if ( stack.size ( ) ) {
-                node = pop ( stack );
-                for ( nid child = tree[ node.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                    if ( tree[ child.id ].fan )
-                        push ( stack, child );
-                return *this;
-            }
-            else {
-                node = rooted_tree_base::invalid;
-                return *this;
-            }
+        else {
+            max_depth = std::max ( max_depth, depth_ );
         }
-        [[nodiscard]] const_reference operator* ( ) const noexcept { return tree[ node.id ]; }
-        [[nodiscard]] const_pointer operator-> ( ) const noexcept { return std::addressof ( tree[ node.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return node; }
-    };
+    }
 
-    class leaf_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base & tree;
-        id_vector stack;
-        nid node;
+    // Re-computes the maximum depth from all hooks (unlinked ones are at depth 0), in parallel.
+    void update_max_depth ( ) {
+        auto local_max = [ this ] ( tbb::blocked_range<size_type> const & r_, size_type max_ ) {
+            for ( size_type i = r_.begin ( ); i != r_.end ( ); ++i )
+                max_ = std::max ( max_, hook ( nid{ i } ).depth );
+            return max_;
+        };
+        auto join  = [] ( size_type a_, size_type b_ ) { return std::max ( a_, b_ ); };
+        auto range = tbb::blocked_range<size_type> ( 0, static_cast<size_type> ( nodes.size ( ) ), grain_size );
+        max_depth  = tbb::parallel_reduce ( range, size_type{ 0 }, local_max, join );
+    }
 
-        public:
-        leaf_iterator ( rooted_tree_base & tree_, nid nid_ = rooted_tree_base::root ) : tree{ tree_ } {
-            for ( nid child = tree[ nid_.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                push ( stack, child );
-            if ( stack.size ( ) )
-                this->operator++ ( );
-            else
-                node = rooted_tree_base::invalid;
-        }
-        [[maybe_unused]] leaf_iterator & operator++ ( ) {
-            while ( true ) {
-                if ( stack.size ( ) ) {
-                    node = pop ( stack );
-                    if ( not tree[ node.id ].fan )
-                        return *this;
-                    for ( nid child = tree[ node.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                        push ( stack, child );
-                }
-                else {
-                    node = rooted_tree_base::invalid;
-                    return *this;
+    // Calls level_ ( width ) for every level of the sub-tree rooted at rid_, top down. Wide levels are expanded
+    // in parallel, into per-thread frontiers.
+    template<typename Level>
+    void for_each_level ( nid rid_, Level && level_ ) const {
+        id_vector frontier ( 1, rid_ ), next;
+        tbb::enumerable_thread_specific<id_vector> local_next;
+        while ( frontier.size ( ) ) {
+            level_ ( static_cast<size_type> ( frontier.size ( ) ) );
+            next.clear ( );
+            if ( frontier.size ( ) <= static_cast<std::size_t> ( grain_size ) ) {
+                for ( nid parent : frontier )
+                    for ( nid child = hook ( parent ).tail; child.is_valid ( ); child = hook ( child ).prev )
+                        push ( next, child );
+            }
+            else {
+                auto expand = [ & ] ( tbb::blocked_range<std::size_t> const & r_ ) {
+                    id_vector & local = local_next.local ( );
+                    for ( std::size_t i = r_.begin ( ); i != r_.end ( ); ++i )
+                        for ( nid child = hook ( frontier[ i ] ).tail; child.is_valid ( ); child = hook ( child ).prev )
+                            push ( local, child );
+                };
+                tbb::parallel_for ( tbb::blocked_range<std::size_t> ( 0, frontier.size ( ), grain_size ), expand );
+                for ( id_vector & local : local_next ) {
+                    next.insert ( next.end ( ), local.begin ( ), local.end ( ) );
+                    local.clear ( );
                 }
             }
+            frontier.swap ( next );
         }
-        [[nodiscard]] reference operator* ( ) const noexcept { return tree[ node.id ]; }
-        [[nodiscard]] pointer operator-> ( ) const noexcept { return std::addressof ( tree[ node.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return node; }
-    };
-
-    class const_leaf_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base const & tree;
-        id_vector stack;
-        nid node;
+    }
 
-        public:
-        const_leaf_iterator ( rooted_tree_base const & tree_, nid nid_ = rooted_tree_base::root ) : tree{ tree_ } {
-            for ( nid child = tree[ nid_.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
+    // Pre-order, in depth_iterator order.
+    [[nodiscard]] id_vector depth_first_order ( nid rid_ ) const {
+        id_vector order, stack ( 1, rid_ );
+        order.reserve ( nodes.size ( ) );
+        while ( stack.size ( ) ) {
+            nid node = pop ( stack );
+            push ( order, node );
+            for ( nid child = hook ( node ).tail; child.is_valid ( ); child = hook ( child ).prev )
                 push ( stack, child );
-            if ( stack.size ( ) )
-                this->operator++ ( );
-            else
-                node = rooted_tree_base::invalid;
-        }
-        [[maybe_unused]] const_leaf_iterator & operator++ ( ) {
-            while ( true ) {
-                if ( stack.size ( ) ) {
-                    node = pop ( stack );
-                    if ( not tree[ node.id ].fan )
-                        return *this;
-                    for ( nid child = tree[ node.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                        push ( stack, child );
-                }
-                else {
-                    node = rooted_tree_base::invalid;
-                    return *this;
-                }
-            }
         }
-        [[nodiscard]] const_reference operator* ( ) const noexcept { return tree[ node.id ]; }
-        [[nodiscard]] const_pointer operator-> ( ) const noexcept { return std::addressof ( tree[ node.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return node; }
-    };
+        return order;
+    }
 
-    class depth_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base & tree;
-        id_vector stack;
-        nid node;
+    // Level-order, in breadth_iterator order.
+    [[nodiscard]] id_vector breadth_first_order ( nid rid_ ) const {
+        id_vector order ( 1, rid_ );
+        order.reserve ( nodes.size ( ) );
+        for ( std::size_t i = 0; i < order.size ( ); ++i )
+            for ( nid child = hook ( order[ i ] ).tail; child.is_valid ( ); child = hook ( child ).prev )
+                push ( order, child );
+        return order;
+    }
 
-        public:
-        depth_iterator ( rooted_tree_base & tree_, nid nid_ = rooted_tree_base::root ) : tree{ tree_ }, node{ nid_ } {
-            for ( nid child = tree[ node.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                push ( stack, child );
+    // The top half of the levels is laid out recursively, followed by each of the (recursively laid out)
+    // sub-trees hanging off it.
+    [[nodiscard]] id_vector van_emde_boas_order ( nid rid_ ) const {
+        id_vector const level_order = breadth_first_order ( rid_ );
+        std::vector<size_type> levels ( nodes.size ( ), 1 ); // Of the sub-tree rooted at a node.
+        for ( auto it = level_order.rbegin ( ); it != level_order.rend ( ); ++it )
+            if ( nid up = hook ( *it ).up; up.is_valid ( ) and levels[ up.id ] <= levels[ it->id ] )
+                levels[ up.id ] = levels[ it->id ] + 1;
+        id_vector order;
+        order.reserve ( level_order.size ( ) );
+        van_emde_boas_order_impl ( rid_, levels[ rid_.id ], levels, order );
+        return order;
+    }
+
+    void van_emde_boas_order_impl ( nid rid_, size_type levels_, std::vector<size_type> const & levels, id_vector & order_ ) const {
+        if ( 1 == levels_ ) {
+            push ( order_, rid_ );
+            return;
         }
-        [[maybe_unused]] depth_iterator & operator++ ( ) {
-            if ( stack.size ( ) ) {
-                node = pop ( stack );
-                for ( nid child = tree[ node.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                    push ( stack, child );
-                return *this;
-            }
-            else {
-                node = rooted_tree_base::invalid;
-                return *this;
+        size_type const top = levels_ / 2;
+        van_emde_boas_order_impl ( rid_, top, levels, order_ );
+        // The nodes top levels below rid_ root the bottom sub-trees.
+        std::vector<std::pair<nid, size_type>> stack ( 1, { rid_, 0 } );
+        id_vector bottom;
+        while ( stack.size ( ) ) {
+            auto [ node, depth ] = stack.back ( );
+            stack.pop_back ( );
+            for ( nid child = hook ( node ).tail; child.is_valid ( ); child = hook ( child ).prev )
+                if ( depth + 1 == top )
+                    push ( bottom, child );
+                else
+                    stack.emplace_back ( child, depth + 1 );
+        }
+        for ( nid child : bottom )
+            van_emde_boas_order_impl ( child, std::min<size_type> ( levels_ - top, levels[ child.id ] ), levels, order_ );
+    }
+
+    // Moves the nodes in order_ to new storage, order_[ i ] becomes nid i + 1, order_[ 0 ] becomes the root-node.
+    // Nodes not in order_ are dropped. Returns the old to new nid mapping.
+    [[nodiscard]] id_vector compact ( id_vector const & order_ ) {
+        size_type const size = static_cast<size_type> ( order_.size ( ) );
+        id_vector map ( nodes.size ( ) ); // Zeroed, i.e. invalid.
+        for ( size_type i = 0; i < size; ++i )
+            map[ order_[ i ].id ] = nid{ static_cast<size_type> ( i + 1 ) };
+        [[maybe_unused]] size_type base = 0; // The depth of the new root-node.
+        if constexpr ( has_depth::value )
+            base = hook ( order_[ 0 ] ).depth;
+        rooted_tree_base compacted;
+        compacted.reserve ( size + 1 );
+        compacted.nodes.resize ( size + 1 );
+        if constexpr ( is_split::value )
+            compacted.hooks.resize ( size + 1 );
+        auto move = [ & ] ( tbb::blocked_range<size_type> const & r_ ) {
+            for ( size_type i = r_.begin ( ); i != r_.end ( ); ++i ) {
+                nid const old = order_[ i ], cid = nid{ static_cast<size_type> ( i + 1 ) };
+                if constexpr ( is_split::value )
+                    compacted.hook ( cid ) = hook ( old );
+                compacted[ cid ] = std::move ( nodes[ old.id ] );
+                hook_type & h    = compacted.hook ( cid );
+                h.up             = map[ h.up.id ];
+                h.prev           = map[ h.prev.id ];
+                h.tail           = map[ h.tail.id ];
+                if constexpr ( has_depth::value )
+                    h.depth = static_cast<size_type> ( h.depth - base );
             }
+        };
+        tbb::parallel_for ( tbb::blocked_range<size_type> ( 0, size, grain_size ), move );
+        compacted.hook ( invalid ).tail = root;
+        compacted.hook ( invalid ).fan  = 1;
+        nodes.swap ( compacted.nodes );
+        if constexpr ( is_split::value )
+            hooks.swap ( compacted.hooks );
+        free_list.clear ( );
+        if constexpr ( is_concurrent::value ) {
+            thread_local_data.clear ( );
+            free_list_end = 0;
+            publish_all ( );
         }
-        [[nodiscard]] reference operator* ( ) const noexcept { return tree[ node.id ]; }
-        [[nodiscard]] pointer operator-> ( ) const noexcept { return std::addressof ( tree[ node.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return node; }
-    };
+        if constexpr ( has_depth::value )
+            update_max_depth ( );
+        return map;
+    }
 
-    class const_depth_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base const & tree;
-        id_vector stack;
-        nid node;
+    // Re-constructs the payload of the (reserved or recycled, default constructed) node at cid_, its hook is left
+    // as it is (unlinked), of the concurrent tree, other threads may be probing it (is_linked ( )). Initialized with
+    // parentheses, like the emplace_back ( ) of a new node.
+    template<typename... Args>
+    void construct ( nid cid_, Args &&... args_ ) {
+        value_type * cnode = std::addressof ( nodes[ cid_.id ] );
+        if constexpr ( is_concurrent::value and not is_split::value ) {
+            static_assert ( std::is_trivially_copyable<value_type>::value and
+                                std::has_unique_object_representations<hook_type>::value,
+                            "a concurrent tree needs a trivially copyable Node (deriving from a Hook without padding)" );
+            value_type const node ( std::forward<Args> ( args_ )... );
+            char * const to           = reinterpret_cast<char *> ( cnode );
+            char const * const from   = reinterpret_cast<char const *> ( std::addressof ( node ) );
+            std::size_t const hook_b  = static_cast<std::size_t> (
+                reinterpret_cast<char const *> ( static_cast<hook_type const *> ( std::addressof ( node ) ) ) - from );
+            std::size_t const after_b = hook_b + sizeof ( hook_type );
+            std::memcpy ( to, from, hook_b );
+            std::memcpy ( to + after_b, from + after_b, sizeof ( value_type ) - after_b );
+        }
+        else {
+            cnode->~value_type ( );
+            new ( cnode ) value_type ( std::forward<Args> ( args_ )... );
+        }
+    }
 
-        public:
-        const_depth_iterator ( rooted_tree_base const & tree_, nid nid_ = rooted_tree_base::root ) : tree{ tree_ }, node{ nid_ } {
-            for ( nid child = tree[ node.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                push ( stack, child );
+    // Resets the hook of a recycled node, of the concurrent tree (the members it knows of) with atomic stores, other
+    // threads may be probing it (is_linked ( )).
+    void reset_hook ( nid nid_ ) noexcept {
+        hook_type & h = hook ( nid_ );
+        if constexpr ( is_concurrent::value ) {
+            hook_type const reset{ };
+            as_atomic ( h.up ).store ( reset.up, std::memory_order_relaxed );
+            as_atomic ( h.prev ).store ( reset.prev, std::memory_order_relaxed );
+            as_atomic ( h.tail ).store ( reset.tail, std::memory_order_relaxed );
+            as_atomic ( h.fan ).store ( reset.fan, std::memory_order_relaxed );
+            if constexpr ( has_depth::value )
+                as_atomic ( h.depth ).store ( reset.depth, std::memory_order_relaxed );
+            if constexpr ( has_subtree_size::value )
+                as_atomic ( h.subtree_size ).store ( reset.subtree_size, std::memory_order_relaxed );
+            if constexpr ( has_epoch::value )
+                as_atomic ( h.epoch ).store ( reset.epoch, std::memory_order_relaxed );
         }
-        [[maybe_unused]] const_depth_iterator & operator++ ( ) {
-            if ( stack.size ( ) ) {
-                node = pop ( stack );
-                for ( nid child = tree[ node.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                    push ( stack, child );
-                return *this;
-            }
-            else {
-                node = rooted_tree_base::invalid;
-                return *this;
-            }
+        else {
+            h = hook_type{ };
         }
-        [[nodiscard]] const_reference operator* ( ) const noexcept { return tree[ node.id ]; }
-        [[nodiscard]] const_pointer operator-> ( ) const noexcept { return std::addressof ( tree[ node.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return node; }
-    };
+    }
 
-    // It is safe to destroy the node the interator is pointing at. Note: breadth_iterator is a (rather) heavy object.
-    class breadth_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base & tree;
-        id_deque queue;
-        size_type max_depth, depth, count;
-        nid parent;
-
-        public:
-        breadth_iterator ( rooted_tree_base & tree_, size_type max_depth_ = 0, nid nid_ = rooted_tree_base::root ) :
-            tree{ tree_ }, max_depth{ max_depth_ }, parent{ nid_ } {
-            if ( ( not max_depth ) or ( max_depth > 1 ) )
-                for ( nid child = tree[ parent.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                    en ( queue, child );
-            count = static_cast<size_type> ( queue.size ( ) );
-            depth = 1 + static_cast<size_type> ( 0 != count );
-        }
-        [[maybe_unused]] breadth_iterator & operator++ ( ) {
-            if ( size_type queue_size = static_cast<size_type> ( queue.size ( ) ); static_cast<bool> ( queue_size ) ) {
-                if ( not count ) {
-                    count = queue_size;
-                    if ( ( not max_depth ) or ( max_depth > 1 ) ) {
-                        if ( max_depth == depth++ ) {
-                            parent = rooted_tree_base::invalid;
-                            return *this;
-                        }
-                    }
+    // Stamps a node with the current epoch. A concurrent writer registers as in flight for that epoch, which holds
+    // if it is still current after registering, returns the stripe it registered in.
+    [[nodiscard]] int stamp_epoch ( [[maybe_unused]] hook_type & hook_ ) noexcept {
+        if constexpr ( has_epoch::value ) {
+            if constexpr ( is_concurrent::value ) {
+                int const stripe = thread_stripe ( );
+                epoch_type current = epoch.load ( );
+                while ( true ) {
+                    epoch_writers_data[ stripe ].count[ current & 1 ].fetch_add ( 1 );
+                    epoch_type const now = epoch.load ( );
+                    if ( now == current )
+                        break;
+                    epoch_writers_data[ stripe ].count[ current & 1 ].fetch_sub ( 1, std::memory_order_release );
+                    current = now;
                 }
-                parent = de ( queue );
-                count -= 1;
-                for ( nid child = tree[ parent.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                    en ( queue, child );
-                return *this;
+                hook_.epoch = current;
+                return stripe;
             }
             else {
-                parent = rooted_tree_base::invalid;
-                return *this;
+                hook_.epoch = epoch;
             }
         }
-        [[nodiscard]] reference operator* ( ) const noexcept { return tree[ parent.id ]; }
-        [[nodiscard]] pointer operator-> ( ) const noexcept { return std::addressof ( tree[ parent.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return parent.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return parent; }
-        [[nodiscard]] size_type height ( ) const noexcept { return depth; }
-    };
+        return 0;
+    }
 
-    // It is safe to destroy the node the interator is pointing at. Note: breadth_iterator is a (rather) heavy object.
-    class const_breadth_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base const & tree;
-        id_deque queue;
-        size_type max_depth, depth, count;
-        nid parent;
-
-        public:
-        const_breadth_iterator ( rooted_tree_base const & tree_, size_type max_depth_ = 0, nid nid_ = rooted_tree_base::root ) :
-            tree{ tree_ }, max_depth{ max_depth_ }, parent{ nid_ } {
-            if ( ( not max_depth ) or ( max_depth > 1 ) )
-                for ( nid child = tree[ parent.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                    en ( queue, child );
-            count = static_cast<size_type> ( queue.size ( ) );
-            depth = 1 + static_cast<size_type> ( 0 != count );
-        }
-        [[maybe_unused]] const_breadth_iterator & operator++ ( ) {
-            if ( size_type queue_size = static_cast<size_type> ( queue.size ( ) ); static_cast<bool> ( queue_size ) ) {
-                if ( not count ) {
-                    count = queue_size;
-                    if ( ( not max_depth ) or ( max_depth > 1 ) ) {
-                        if ( max_depth == depth++ ) {
-                            parent = rooted_tree_base::invalid;
-                            return *this;
-                        }
-                    }
+    [[nodiscard]] nid insert_impl ( nid pid_, nid cid_ ) {
+        assert ( invalid != pid_ or hook ( invalid ).tail.is_invalid ( ) ); // no 2+ roots.
+        hook_type & chook                 = hook ( cid_ );
+        [[maybe_unused]] int const stripe = stamp_epoch ( chook );
+        if constexpr ( has_depth::value ) {
+            chook.depth = pid_.is_valid ( ) ? static_cast<size_type> ( hook ( pid_ ).depth + 1 ) : 0;
+            raise_max_depth ( chook.depth );
+        }
+        if constexpr ( is_concurrent::value ) {
+            // From here on the node is_linked ( ), a valid parent, the release publishes it (and its depth).
+            as_atomic ( chook.up ).store ( pid_, std::memory_order_release );
+            // The node is constructed in a slot reserved by this thread, the release on tail publishes it.
+            std::atomic<nid> & ptail = as_atomic ( hook ( pid_ ).tail );
+            chook.prev               = ptail.load ( std::memory_order_relaxed );
+            while ( not ptail.compare_exchange_weak ( chook.prev, cid_, std::memory_order_release, std::memory_order_relaxed ) )
+                ; // prepend to the sibling list.
+            as_atomic ( hook ( pid_ ).fan ).fetch_add ( 1, std::memory_order_relaxed );
+            if constexpr ( has_epoch::value )
+                epoch_writers_data[ stripe ].count[ chook.epoch & 1 ].fetch_sub ( 1, std::memory_order_release );
+        }
+        else {
+            chook.up   = pid_;
+            chook.prev = std::exchange ( hook ( pid_ ).tail, cid_ );
+            hook ( pid_ ).fan += 1;
+        }
+        if constexpr ( has_subtree_size::value ) {
+            if constexpr ( has_lazy_subtree_size::value ) {
+                if constexpr ( is_concurrent::value ) {
+                    // Test first, not to write the shared cache line on every insertion.
+                    if ( not subtree_sizes_dirty.load ( std::memory_order_relaxed ) )
+                        subtree_sizes_dirty.store ( true, std::memory_order_relaxed );
+                }
+                else {
+                    subtree_sizes_dirty = true;
                 }
-                parent = de ( queue );
-                count -= 1;
-                for ( nid child = tree[ parent.id ].tail; child.is_valid ( ); child = tree[ child.id ].prev )
-                    en ( queue, child );
-                return *this;
             }
             else {
-                parent = rooted_tree_base::invalid;
-                return *this;
+                for ( nid node = pid_; node.is_valid ( ); node = hook ( node ).up )
+                    if constexpr ( is_concurrent::value )
+                        as_atomic ( hook ( node ).subtree_size ).fetch_add ( 1, std::memory_order_relaxed );
+                    else
+                        hook ( node ).subtree_size += 1;
             }
         }
-        [[nodiscard]] const_reference operator* ( ) const noexcept { return tree[ parent.id ]; }
-        [[nodiscard]] const_pointer operator-> ( ) const noexcept { return std::addressof ( tree[ parent.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return parent.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return parent; }
-        [[nodiscard]] size_type height ( ) const noexcept { return depth; }
-    };
+        return cid_;
+    }
 
-    class out_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base & tree;
-        nid node;
+#if USE_CEREAL
+    private:
+    friend class cereal::access;
+    template<class Archive>
+    inline void serialize ( Archive & ar_ ) {
+        if constexpr ( is_split::value )
+            ar_ ( hooks, nodes );
+        else
+            ar_ ( nodes );
+    }
+#endif
+};
 
-        public:
-        out_iterator ( rooted_tree_base & tree_, nid nid_ ) noexcept : tree{ tree_ }, node{ tree[ nid_.id ].tail } {}
-        [[maybe_unused]] out_iterator & operator++ ( ) noexcept {
-            node = tree[ node.id ].prev;
-            return *this;
-        }
-        [[nodiscard]] reference operator* ( ) const noexcept { return tree[ node.id ]; }
-        [[nodiscard]] pointer operator-> ( ) const noexcept { return std::addressof ( tree[ node.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return node; }
-    };
+// The hook of a node as seen by a snapshot, its links restricted to the visible nodes. The fan is not part of it,
+// counting the visible children is O(fan), whether a node has any is tail.is_valid ( ).
+template<typename Index>
+struct basic_snapshot_hook {
+    using index_type = Index;
 
-    class const_out_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base const & tree;
-        nid node;
+    basic_nid<Index> up = basic_nid<Index>{ 0 }, prev = basic_nid<Index>{ 0 }, tail = basic_nid<Index>{ 0 };
+    epoch_type epoch = 0;
+};
 
-        public:
-        const_out_iterator ( rooted_tree_base const & tree_, nid nid_ ) noexcept : tree{ tree_ }, node{ tree[ nid_.id ].tail } {}
-        [[maybe_unused]] const_out_iterator & operator++ ( ) noexcept {
-            node = tree[ node.id ].prev;
-            return *this;
-        }
-        [[nodiscard]] const_reference operator* ( ) const noexcept { return tree[ node.id ]; }
-        [[nodiscard]] const_pointer operator-> ( ) const noexcept { return std::addressof ( tree[ node.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return node; }
-    };
+template<typename Index>
+struct basic_snapshot_depth_hook : basic_snapshot_hook<Index> {
+    Index depth = 0;
+};
 
-    class up_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base & tree;
-        nid node;
+// A read-only view of a tree (with an epoch hook) as it was when the snapshot was taken, nodes stamped with a
+// later epoch are skipped. The hooks are returned by value, with the links restricted to the visible nodes, which
+// is what makes the iterators and parallel algorithms work on it unchanged. Traversal is safe/concurrent with
+// insertion (not with erasure), the fan and the sub-tree sizes (if any) are not part of the view.
+template<typename Tree>
+class basic_snapshot {
 
-        public:
-        up_iterator ( rooted_tree_base & tree_, nid nid_ ) noexcept : tree{ tree_ }, node{ nid_ } {}
-        [[maybe_unused]] up_iterator & operator++ ( ) noexcept {
-            node = tree[ node.id ].up;
-            return *this;
-        }
-        [[nodiscard]] reference operator* ( ) const noexcept { return tree[ node.id ]; }
-        [[nodiscard]] pointer operator-> ( ) const noexcept { return std::addressof ( tree[ node.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return node; }
-    };
+    public:
+    using value_type      = typename Tree::value_type;
+    using hook_type       = std::conditional_t<Tree::has_depth::value, basic_snapshot_depth_hook<typename Tree::index_type>,
+                                               basic_snapshot_hook<typename Tree::index_type>>;
+    using index_type      = typename Tree::index_type;
+    using nid             = typename Tree::nid;
+    using size_type       = typename Tree::size_type;
+    using difference_type = typename Tree::difference_type;
+    using reference       = value_type const &;
+    using pointer         = value_type const *;
+    using const_reference = value_type const &;
+    using const_pointer   = value_type const *;
+
+    static constexpr nid invalid = Tree::invalid;
+    static constexpr nid root    = Tree::root;
+
+    static constexpr size_type grain_size = Tree::grain_size;
+
+    basic_snapshot ( Tree const & tree_, epoch_type epoch_ ) noexcept : tree{ tree_ }, pinned{ epoch_ } {}
+
+    [[nodiscard]] value_type const & operator[] ( nid nid_ ) const noexcept { return tree[ nid_ ]; }
+    [[nodiscard]] value_type const & operator[] ( size_type nid_ ) const noexcept { return tree[ nid_ ]; }
+
+    [[nodiscard]] hook_type hook ( nid nid_ ) const noexcept {
+        auto const & source = tree.hook ( nid_ );
+        hook_type view;
+        view.up    = source.up;
+        view.epoch = source.epoch;
+        if constexpr ( Tree::has_depth::value )
+            view.depth = source.depth;
+        // Only the (published) prev of a visible node is read, the tail is the acquire, the writer's release pairs with.
+        view.prev = visible ( source.prev );
+        view.tail = visible ( load_tail ( source ) );
+        return view;
+    }
 
-    class const_up_iterator {
-        friend struct rooted_tree_base;
-        rooted_tree_base const & tree;
-        nid node;
+    // The pinned epoch, nodes stamped with it, or before, are visible.
+    [[nodiscard]] epoch_type epoch ( ) const noexcept { return pinned; }
+    [[nodiscard]] bool is_visible ( nid nid_ ) const noexcept { return tree.hook ( nid_ ).epoch <= pinned; }
 
-        public:
-        const_up_iterator ( rooted_tree_base const & tree_, nid nid_ ) noexcept : tree{ tree_ }, node{ nid_ } {}
-        [[maybe_unused]] const_up_iterator & operator++ ( ) noexcept {
-            node = tree[ node.id ].up;
-            return *this;
-        }
-        [[nodiscard]] const_reference operator* ( ) const noexcept { return tree[ node.id ]; }
-        [[nodiscard]] const_pointer operator-> ( ) const noexcept { return std::addressof ( tree[ node.id ] ); }
-        [[nodiscard]] bool is_valid ( ) const noexcept { return node.is_valid ( ); }
-        [[nodiscard]] nid id ( ) const noexcept { return node; }
-    };
+    using const_internal_iterator   = basic_internal_iterator<basic_snapshot const>;
+    using const_leaf_iterator       = basic_leaf_iterator<basic_snapshot const>;
+    using const_depth_iterator      = basic_depth_iterator<basic_snapshot const>;
+    using const_pre_order_iterator  = basic_pre_order_iterator<basic_snapshot const>;
+    using const_post_order_iterator = basic_post_order_iterator<basic_snapshot const>;
+    using const_breadth_iterator    = basic_breadth_iterator<basic_snapshot const>;
+    using const_out_iterator        = basic_out_iterator<basic_snapshot const>;
+    using const_up_iterator         = basic_up_iterator<basic_snapshot const>;
 
-    // The (maximum) depth (or height) is the number of nodes along the longest path from the (by default
-    // root-node) node down to the farthest leaf node. It returns (optionally) the width_ through an out-pointer.
-    [[nodiscard]] size_type height ( nid rid_ = root, size_type * width_ = nullptr ) const {
-        id_deque queue ( 1, rid_ );
-        size_type max_width = 0, depth = 0, count = 1;
-        while ( count ) {
-            while ( count-- ) {
-                nid parent = de ( queue );
-                for ( nid child = nodes[ parent.id ].tail; child.is_valid ( ); child = nodes[ child.id ].prev )
-                    en ( queue, child );
-            }
-            count = static_cast<size_type> ( queue.size ( ) );
-            if ( count > max_width )
-                max_width = count;
-            depth += 1;
-        }
-        if ( width_ )
-            *width_ = max_width;
-        return depth;
+    private:
+    [[nodiscard]] static nid load_tail ( typename Tree::hook_type const & hook_ ) noexcept {
+        if constexpr ( Tree::is_concurrent::value )
+            return as_atomic ( const_cast<nid &> ( hook_.tail ) ).load ( std::memory_order_acquire );
+        else
+            return hook_.tail;
     }
 
-    data nodes;
+    // The first visible node on the sibling list from nid_ on, a node, that is inserted later, can be
+    // prepended before, as well as after, an earlier one.
+    [[nodiscard]] nid visible ( nid nid_ ) const noexcept {
+        while ( nid_.is_valid ( ) and not is_visible ( nid_ ) )
+            nid_ = tree.hook ( nid_ ).prev;
+        return nid_;
+    }
 
-    static constexpr nid invalid = nid{ 0 }, root = nid{ 1 };
+    Tree const & tree;
+    epoch_type pinned;
+};
 
-    private:
-    template<typename AccessType>
-    [[nodiscard]] nid insert_impl ( nid pid_, AccessType & cnode_, nid cid_ ) {
-        assert ( invalid != pid_ or nodes[ invalid.id ].tail.is_invalid ( ) ); // no 2+ roots.
-        if constexpr ( is_concurrent::value ) {
-            while ( cid_.id >= nodes.size ( ) ) // await allocation.
-                std::this_thread::yield ( );
-            while ( not nodes[ cid_.id ].done ) // await construction.
-                std::this_thread::yield ( );
-            cnode_->up = pid_;
-            {
-                scoped_lock lock ( nodes[ pid_.id ].lock );
-                cnode_->prev = std::exchange ( nodes[ pid_.id ].tail, cid_ );
-                nodes[ pid_.id ].fan++;
-            }
-            return cid_;
-        }
-        else {
-            cnode_.up   = pid_;
-            cnode_.prev = std::exchange ( nodes[ pid_.id ].tail, cid_ );
-            nodes[ pid_.id ].fan += 1;
-            return cid_;
+// Parallel algorithms.
+
+// Visits the sub-trees rooted at the nids on stack_, serially, in pre-order. After every Tree::grain_size visits,
+// the bottom half of the stack (the nodes closest to the top, rooting the larger sub-trees) is handed to a new task,
+// a stack of 1 (f.e. walking a chain of only-children) is not split.
+template<typename Tree, typename Visit>
+void parallel_visit_impl ( Tree & tree_, basic_id_vector<typename Tree::nid> stack_, Visit & visit_, tbb::task_group & tasks_ ) {
+    using nid       = typename Tree::nid;
+    using id_vector = basic_id_vector<nid>;
+    std::size_t visits = 0;
+    while ( stack_.size ( ) ) {
+        if ( ++visits > static_cast<std::size_t> ( Tree::grain_size ) and stack_.size ( ) > 1 ) {
+            auto const half = stack_.begin ( ) + static_cast<std::ptrdiff_t> ( stack_.size ( ) / 2 );
+            tasks_.run ( [ &tree_, &visit_, &tasks_, split = id_vector ( stack_.begin ( ), half ) ] {
+                parallel_visit_impl ( tree_, split, visit_, tasks_ );
+            } );
+            stack_.erase ( stack_.begin ( ), half );
+            visits = 1;
         }
+        nid const node = pop ( stack_ );
+        visit_ ( node );
+        for ( nid child = tree_.hook ( node ).tail; child.is_valid ( ); child = tree_.hook ( child ).prev )
+            push ( stack_, child );
     }
+}
 
-#if USE_CEREAL
-    private:
-    friend class cereal::access;
-    template<class Archive>
-    inline void serialize ( Archive & ar_ ) {
-        ar_ ( nodes );
+// Visits (by nid) all nodes of the sub-tree rooted at nid_, in parallel, on the TBB work-stealing scheduler. A
+// parent is always visited before its children, visit_ is called concurrently.
+template<typename Tree, typename Visit>
+void parallel_visit ( Tree & tree_, typename Tree::nid nid_, Visit && visit_ ) {
+    tbb::task_group tasks;
+    parallel_visit_impl ( tree_, basic_id_vector<typename Tree::nid> ( 1, nid_ ), visit_, tasks );
+    tasks.wait ( );
+}
+
+// The result of a node, from the results of its children.
+template<typename Tree, typename Leaf, typename Combine, typename Out>
+void reduce_node ( Tree & tree_, typename Tree::nid nid_, Leaf & leaf_, Combine & combine_, Out & out_ ) {
+    using nid = typename Tree::nid;
+    auto result = leaf_ ( tree_[ nid_ ] );
+    for ( nid child = tree_.hook ( nid_ ).tail; child.is_valid ( ); child = tree_.hook ( child ).prev )
+        result = combine_ ( std::move ( result ), out_[ child.id ] );
+    out_[ nid_.id ] = std::move ( result );
+}
+
+// Reduces the sub-trees rooted at the nids in roots_, serially, depth-first, off an explicit stack of frames (a node
+// and the next of its children to descend into), leaves are evaluated in place. After every Tree::grain_size nodes,
+// the remaining children of the top-most frame that has any (rooting the larger sub-trees) are handed to a new task,
+// as one batch, the frame waits for it before its node is reduced. A chain of only-children is never split.
+template<typename Tree, typename Leaf, typename Combine, typename Out>
+void reduce_up_impl ( Tree & tree_, basic_id_vector<typename Tree::nid> const & roots_, Leaf & leaf_, Combine & combine_,
+                      Out & out_ ) {
+    using nid       = typename Tree::nid;
+    using id_vector = basic_id_vector<nid>;
+    struct frame {
+        nid node, next;
+        std::unique_ptr<tbb::task_group> tasks;
+    };
+    std::vector<frame> stack;
+    std::size_t open = 0, visits = 0; // The frames below open have no children left.
+    for ( nid rid : roots_ ) {
+        stack.push_back ( { rid, tree_.hook ( rid ).tail, nullptr } );
+        while ( stack.size ( ) ) {
+            if ( nid const child = stack.back ( ).next; child.is_valid ( ) ) {
+                stack.back ( ).next = tree_.hook ( child ).prev;
+                if ( nid const tail = tree_.hook ( child ).tail; tail.is_valid ( ) )
+                    stack.push_back ( { child, tail, nullptr } );
+                else
+                    out_[ child.id ] = leaf_ ( tree_[ child ] );
+                if ( ++visits <= static_cast<std::size_t> ( Tree::grain_size ) )
+                    continue;
+                while ( open < stack.size ( ) and stack[ open ].next.is_invalid ( ) )
+                    ++open;
+                if ( open == stack.size ( ) )
+                    continue;
+                frame & split = stack[ open ];
+                id_vector batch;
+                for ( nid node = split.next; node.is_valid ( ); node = tree_.hook ( node ).prev )
+                    if ( tree_.hook ( node ).tail.is_valid ( ) )
+                        push ( batch, node );
+                    else
+                        out_[ node.id ] = leaf_ ( tree_[ node ] );
+                split.next = Tree::invalid;
+                if ( batch.size ( ) ) {
+                    if ( not split.tasks )
+                        split.tasks = std::make_unique<tbb::task_group> ( );
+                    split.tasks->run ( [ &tree_, &leaf_, &combine_, &out_, batch = std::move ( batch ) ] {
+                        reduce_up_impl ( tree_, batch, leaf_, combine_, out_ );
+                    } );
+                }
+                visits = 0;
+                continue;
+            }
+            frame & top = stack.back ( );
+            if ( top.tasks )
+                top.tasks->wait ( );
+            reduce_node ( tree_, top.node, leaf_, combine_, out_ );
+            stack.pop_back ( );
+            open = std::min ( open, stack.size ( ) );
+        }
     }
-#endif
-};
+}
 
 } // namespace detail
 
-using rooted_tree_hook = detail::rooted_tree_hook;
-template<typename Node>
-using rooted_tree = detail::rooted_tree_base<Node, false>;
-template<typename Node>
-using concurrent_rooted_tree = detail::rooted_tree_base<Node, true>;
+// Calls f_ ( node ) for all nodes of the sub-tree rooted at nid_, in parallel, f_ is called concurrently.
+template<typename Tree, typename F>
+void parallel_for_each ( Tree & tree_, typename Tree::nid nid_, F && f_ ) {
+    detail::parallel_visit ( tree_, nid_, [ &tree_, &f_ ] ( auto n_ ) { f_ ( tree_[ n_ ] ); } );
+}
+
+// Calls f_ ( node ) for all leaf-nodes of the sub-tree rooted at nid_, in parallel, f_ is called concurrently.
+template<typename Tree, typename F>
+void parallel_for_each_leaf ( Tree & tree_, typename Tree::nid nid_, F && f_ ) {
+    detail::parallel_visit ( tree_, nid_, [ &tree_, &f_ ] ( auto n_ ) {
+        if ( tree_.hook ( n_ ).tail.is_invalid ( ) )
+            f_ ( tree_[ n_ ] );
+    } );
+}
+
+// Bottom-up fold over the sub-tree rooted at nid_, children are evaluated before their parent and independent
+// sub-trees in parallel. The result of a node, written to out_[ nid.id ], is its own value leaf_fn_ ( node ) (for
+// a leaf that's it), into which the results of its children are folded, with acc = combine_fn_ ( acc, child ).
+template<typename Tree, typename Leaf, typename Combine, typename Out>
+void reduce_up ( Tree & tree_, typename Tree::nid nid_, Leaf && leaf_fn_, Combine && combine_fn_, Out && out_ ) {
+    detail::reduce_up_impl ( tree_, detail::basic_id_vector<typename Tree::nid> ( 1, nid_ ), leaf_fn_, combine_fn_, out_ );
+}
+
+// Top-down scan over the sub-tree rooted at nid_, a parent is evaluated before its children and independent
+// sub-trees in parallel. The result of nid_, written to out_[ nid_.id ], is seed_, the result of any other node is
+// fn_ ( node, result of its parent ).
+template<typename Tree, typename T, typename F, typename Out>
+void propagate_down ( Tree & tree_, typename Tree::nid nid_, T && seed_, F && fn_, Out && out_ ) {
+    out_[ nid_.id ] = std::forward<T> ( seed_ );
+    detail::parallel_visit ( tree_, nid_, [ &tree_, nid_, &fn_, &out_ ] ( auto n_ ) {
+        if ( n_ != nid_ )
+            out_[ n_.id ] = fn_ ( tree_[ n_ ], out_[ tree_.hook ( n_ ).up.id ] );
+    } );
+}
+
+template<typename Index>
+using basic_rooted_tree_hook = detail::basic_rooted_tree_hook<Index>;
+using rooted_tree_hook       = detail::rooted_tree_hook;
+template<typename Index>
+using basic_depth_hook = detail::basic_depth_hook<Index>;
+using depth_hook       = detail::depth_hook;
+using size_policy      = detail::size_policy;
+template<typename Index, size_policy Policy>
+using basic_size_hook = detail::basic_size_hook<Index, Policy>;
+using eager_size_hook = detail::eager_size_hook;
+using lazy_size_hook  = detail::lazy_size_hook;
+template<typename Index>
+using basic_epoch_hook = detail::basic_epoch_hook<Index>;
+using epoch_hook       = detail::epoch_hook;
+using node_order             = detail::node_order;
+template<typename Node, typename Hook = rooted_tree_hook>
+using rooted_tree = detail::rooted_tree_base<Node, false, Hook>;
+template<typename Node, typename Hook = rooted_tree_hook>
+using concurrent_rooted_tree = detail::rooted_tree_base<Node, true, Hook>;
 } // namespace sax
 
 #undef USE_CEREAL
@@ -49,17 +49,23 @@
 
 #else
 
+#    include <sched.h>
 #    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
 
 #endif
 
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include <atomic>
 #include <algorithm>
+#include <condition_variable>
 #include <initializer_list>
 #include <limits>
 #include <map>
@@ -101,20 +107,6 @@ HEDLEY_ALWAYS_INLINE void cpu_pause ( ) noexcept {
 #endif
 }
 
-bool thread_exited ( std::thread::native_handle_type handle_ ) {
-#if defined( _MSC_VER )
-    FILETIME creationTime;
-    FILETIME exitTime = { 0, 0 };
-    FILETIME kernelTime;
-    FILETIME userTime;
-    GetThreadTimes ( handle_, std::addressof ( creationTime ), std::addressof ( exitTime ), std::addressof ( kernelTime ),
-                     std::addressof ( userTime ) );
-    return exitTime.dwLowDateTime;
-#else
-
-#endif
-}
-
 [[nodiscard]] HEDLEY_ALWAYS_INLINE constexpr std::size_t round_multiple ( std::size_t n_, std::size_t multiple_ ) noexcept {
     n_ += multiple_ - 1;
     n_ /= multiple_;
@@ -130,43 +122,255 @@ bool thread_exited ( std::thread::native_handle_type handle_ ) {
     return pointer_;
 }
 
+// NUMA, nodes beyond this number share the statistics (and slabs) of a lower one.
+inline constexpr unsigned numa_max_nodes = 64;
+
+// The node the calling thread runs on (0 on Windows, where slabs are not bound).
+[[nodiscard]] inline unsigned current_numa_node ( ) noexcept {
+#if defined( _MSC_VER )
+    return 0;
+#else
+    unsigned cpu = 0, node = 0;
+#    if defined( __GLIBC__ ) and ( __GLIBC__ > 2 or ( 2 == __GLIBC__ and __GLIBC_MINOR__ >= 29 ) )
+    if ( HEDLEY_UNLIKELY ( getcpu ( &cpu, &node ) ) ) // vdso.
+        return 0;
+#    else
+    if ( HEDLEY_UNLIKELY ( syscall ( SYS_getcpu, &cpu, &node, nullptr ) ) )
+        return 0;
+#    endif
+    return node % numa_max_nodes;
+#endif
+}
+
+// Sets the memory policy of the (page aligned) range to prefer node_, pages already faulted in are moved. Preferred,
+// not bound, a full node falls back to another, instead of failing the allocation. Returns false on failure (or
+// without NUMA support).
+[[maybe_unused]] inline bool bind_numa_node ( [[maybe_unused]] void * const pointer_, [[maybe_unused]] std::size_t size_,
+                                              [[maybe_unused]] unsigned node_ ) noexcept {
+#if defined( _MSC_VER ) or not defined( SYS_mbind )
+    return false;
+#else
+    constexpr int mpol_preferred = 1, mpol_mf_move = 1 << 1; // <numaif.h>, without the libnuma dependency.
+    constexpr std::size_t word_bits = 8 * sizeof ( unsigned long );
+    unsigned long mask[ numa_max_nodes / word_bits + 1 ] = { };
+    mask[ node_ / word_bits ] = 1ul << ( node_ % word_bits );
+    return not syscall ( SYS_mbind, pointer_, size_, mpol_preferred, mask, numa_max_nodes + 1, mpol_mf_move );
+#endif
+}
+
 namespace vm_vector { // sax::detail::vm_vector
 
-template<typename Pointer>
+#if not defined( _MSC_VER )
+
+// The number of bytes, in [begin_, end_), backed by transparent huge pages (0, if that cannot be read). The kernel
+// counts those per mapping, a mapping that straddles the range adds at most its overlap with it, so this never exceeds
+// end_ - begin_, but is an upper bound where mappings straddle.
+[[nodiscard]] inline std::size_t transparent_huge_b ( void const * begin_, void const * end_ ) noexcept {
+    std::FILE * smaps = std::fopen ( "/proc/self/smaps", "r" );
+    if ( HEDLEY_UNLIKELY ( not smaps ) )
+        return 0;
+    std::uintptr_t const begin = reinterpret_cast<std::uintptr_t> ( begin_ ), end = reinterpret_cast<std::uintptr_t> ( end_ );
+    std::size_t huge_b = 0, overlap_b = 0;
+    char line[ 256 ];
+    while ( std::fgets ( line, sizeof ( line ), smaps ) ) {
+        unsigned long long from, to, kb;
+        if ( 2 == std::sscanf ( line, "%llx-%llx ", &from, &to ) ) { // a mapping.
+            std::uintptr_t const lo = std::max<std::uintptr_t> ( from, begin ), hi = std::min<std::uintptr_t> ( to, end );
+            overlap_b               = lo < hi ? static_cast<std::size_t> ( hi - lo ) : 0;
+        }
+        else if ( overlap_b and 1 == std::sscanf ( line, "AnonHugePages: %llu kB", &kb ) )
+            huge_b += std::min ( static_cast<std::size_t> ( kb ) * 1'024, overlap_b );
+    }
+    std::fclose ( smaps );
+    return huge_b;
+}
+
+#endif
+
+// Reserves address space (without backing it), and commits and decommits it in place, from the front, in multiples
+// of page_size_b. On Linux, the reservation is an inaccessible MAP_NORESERVE mapping, committing makes it
+// accessible (mprotect), decommitting returns the pages (madvise) and makes it inaccessible again.
+//
+// With HugePages, the reservation is aligned to, and committed in multiples of, 2MB. On Linux, a commit is backed by
+// explicit huge pages (MAP_HUGETLB) while the pool of those lasts, and falls back to transparent huge pages
+// (MADV_HUGEPAGE). On Windows large pages cannot be committed piecemeal, the option only aligns.
+template<typename Pointer, bool HugePages = false>
 struct vm {
 
+    static constexpr std::size_t huge_page_size_b = static_cast<std::size_t> ( 2 * 1'024 * 1'024 ); // 2MB
+    static constexpr std::size_t page_size_b      = HugePages ? huge_page_size_b : static_cast<std::size_t> ( 65'536 );
+
+    // Returns nullptr on failure.
     [[nodiscard]] Pointer reserve ( std::size_t size_ ) {
 #if defined( _MSC_VER )
-        return reinterpret_cast<Pointer> ( VirtualAlloc ( nullptr, size_, MEM_RESERVE, PAGE_READWRITE ) );
+        if constexpr ( HugePages ) {
+            // Reserve, and re-reserve at the aligned address, in the released range.
+            char * pointer =
+                reinterpret_cast<char *> ( VirtualAlloc ( nullptr, size_ + huge_page_size_b, MEM_RESERVE, PAGE_NOACCESS ) );
+            if ( HEDLEY_UNLIKELY ( not pointer ) )
+                return nullptr;
+            VirtualFree ( pointer, 0, MEM_RELEASE );
+            return reinterpret_cast<Pointer> (
+                VirtualAlloc ( round_multiple ( pointer, huge_page_size_b ), size_, MEM_RESERVE, PAGE_READWRITE ) );
+        }
+        else {
+            return reinterpret_cast<Pointer> ( VirtualAlloc ( nullptr, size_, MEM_RESERVE, PAGE_READWRITE ) );
+        }
 #else
-        return reinterpret_cast<Pointer> ( mmap ( nullptr, size_, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0 ) );
+        if constexpr ( HugePages ) {
+            // Over-reserve, and trim to the aligned reservation.
+            assert ( 0 == size_ % huge_page_size_b );
+            char * pointer = reinterpret_cast<char *> (
+                mmap ( nullptr, size_ + huge_page_size_b, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0 ) );
+            if ( HEDLEY_UNLIKELY ( MAP_FAILED == reinterpret_cast<void *> ( pointer ) ) )
+                return nullptr;
+            char * aligned = reinterpret_cast<char *> ( round_multiple ( pointer, huge_page_size_b ) );
+            if ( aligned != pointer )
+                munmap ( pointer, static_cast<std::size_t> ( aligned - pointer ) );
+            if ( aligned != pointer + huge_page_size_b )
+                munmap ( aligned + size_, static_cast<std::size_t> ( pointer + huge_page_size_b - aligned ) );
+            advise_huge ( aligned, size_ );
+            return reinterpret_cast<Pointer> ( aligned );
+        }
+        else {
+            void * pointer = mmap ( nullptr, size_, PROT_NONE, MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0 );
+            return HEDLEY_UNLIKELY ( MAP_FAILED == pointer ) ? nullptr : reinterpret_cast<Pointer> ( pointer );
+        }
 #endif
     }
 
+    // Commits size_ bytes following the committed ones, throws std::bad_alloc on failure.
     HEDLEY_NEVER_INLINE void allocate ( void * const pointer_, std::size_t size_ ) {
+        char * const pointer = reinterpret_cast<char *> ( pointer_ ) + committed;
+        assert ( 0 == size_ % page_size_b );
 #if defined( _MSC_VER )
-        if ( HEDLEY_UNLIKELY (
-                 not VirtualAlloc ( reinterpret_cast<char *> ( pointer_ ) + committed, size_, MEM_COMMIT, PAGE_READWRITE ) ) )
+        if ( HEDLEY_UNLIKELY ( not VirtualAlloc ( pointer, size_, MEM_COMMIT, PAGE_READWRITE ) ) )
             throw std::bad_alloc ( );
 #else
-        mmap ( reinterpret_cast<char *> ( pointer_ ) + committed, size_, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1,
-               0 );
+        if constexpr ( HugePages ) {
+            if ( not commit_hugetlb ( pointer, size_ ) ) {
+                // Re-map, a failed MAP_HUGETLB attempt can leave the range unmapped.
+                if ( HEDLEY_UNLIKELY ( MAP_FAILED == mmap ( pointer, size_, PROT_READ | PROT_WRITE,
+                                                            MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED, -1, 0 ) ) )
+                    throw std::bad_alloc ( );
+                advise_huge ( pointer, size_ );
+            }
+        }
+        else {
+            if ( HEDLEY_UNLIKELY ( mprotect ( pointer, size_, PROT_READ | PROT_WRITE ) ) )
+                throw std::bad_alloc ( );
+        }
 #endif
         committed += size_;
     }
 
+    // Decommits the last size_ committed bytes, their content is lost, returns false on failure.
+    [[maybe_unused]] bool deallocate ( void * const pointer_, std::size_t size_ ) noexcept {
+        assert ( size_ <= committed );
+        char * const pointer = reinterpret_cast<char *> ( pointer_ ) + committed - size_;
+#if defined( _MSC_VER )
+        if ( HEDLEY_UNLIKELY ( not VirtualFree ( pointer, size_, MEM_DECOMMIT ) ) )
+            return false;
+#else
+        if constexpr ( HugePages ) {
+            // Re-reserve, which returns explicit huge pages to their pool as well.
+            if ( HEDLEY_UNLIKELY ( MAP_FAILED == mmap ( pointer, size_, PROT_NONE,
+                                                        MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE | MAP_FIXED, -1, 0 ) ) )
+                return false;
+            advise_huge ( pointer, size_ );
+            for ( std::size_t i = 0; i < size_ / page_size_b; ++i, hugetlb_pages.pop_back ( ) )
+                hugetlb_b -= hugetlb_pages.back ( ) ? page_size_b : 0;
+        }
+        else {
+            if ( HEDLEY_UNLIKELY ( madvise ( pointer, size_, MADV_DONTNEED ) or mprotect ( pointer, size_, PROT_NONE ) ) )
+                return false;
+        }
+#endif
+        committed -= size_;
+        return true;
+    }
+
+    // Faults in the committed range [pointer_, pointer_ + size_), before use, its content must be zero (untouched).
+    static void populate ( void * const pointer_, std::size_t size_ ) noexcept {
+#if defined( MADV_POPULATE_WRITE )
+        if ( HEDLEY_LIKELY ( not madvise ( pointer_, size_, MADV_POPULATE_WRITE ) ) )
+            return;
+#endif
+        // Older kernels and Windows, a write per (small) page.
+        for ( volatile char *p = reinterpret_cast<char *> ( pointer_ ), *e = p + size_; p < e; p += 4'096 )
+            *p = 0;
+    }
+
+    // Releases the reservation of size_ bytes.
     void free ( void * const pointer_, std::size_t size_ ) noexcept {
 #if defined( _MSC_VER )
         VirtualFree ( pointer_, 0, MEM_RELEASE );
 #else
         munmap ( pointer_, size_ );
 #endif
-        committed = 0;
+        committed = hugetlb_b = 0;
+        hugetlb_pages.clear ( );
+    }
+
+    // The number of committed bytes backed by huge pages, explicit or transparent (which are counted by reading
+    // /proc/self/smaps, it's not for a hot path).
+    [[nodiscard]] std::size_t huge_b ( [[maybe_unused]] void const * const pointer_ ) const noexcept {
+#if defined( _MSC_VER )
+        return 0;
+#else
+        if constexpr ( HugePages )
+            return hugetlb_b + transparent_huge_b ( pointer_, reinterpret_cast<char const *> ( pointer_ ) + committed );
+        else
+            return transparent_huge_b ( pointer_, reinterpret_cast<char const *> ( pointer_ ) + committed );
+#endif
     }
 
     std::size_t committed = 0;
+
+    private:
+#if not defined( _MSC_VER )
+    static void advise_huge ( [[maybe_unused]] char * const pointer_, [[maybe_unused]] std::size_t size_ ) noexcept {
+#    if defined( MADV_HUGEPAGE )
+        madvise ( pointer_, size_, MADV_HUGEPAGE );
+#    endif
+    }
+
+    // Backs the range with explicit huge pages, fails (for good) once the pool is exhausted (or if there is none).
+    [[nodiscard]] bool commit_hugetlb ( [[maybe_unused]] char * const pointer_, std::size_t size_ ) {
+        bool hugetlb = false;
+#    if defined( MAP_HUGETLB )
+        hugetlb = hugetlb_available and MAP_FAILED != mmap ( pointer_, size_, PROT_READ | PROT_WRITE,
+                                                             MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED | MAP_HUGETLB, -1, 0 );
+        hugetlb_available = hugetlb;
+#    endif
+        hugetlb_pages.insert ( hugetlb_pages.end ( ), size_ / page_size_b, hugetlb );
+        hugetlb_b += hugetlb ? size_ : 0;
+        return hugetlb;
+    }
+#endif
+
+    // Per committed page (HugePages only), whether it is an explicit huge page.
+    std::vector<bool> hugetlb_pages;
+    std::size_t hugetlb_b  = 0;
+    bool hugetlb_available = true;
+};
+
+// Growth policies, grow ( ) returns the number of bytes to have committed, when committed_b_ bytes are full (0 at
+// first), the result is rounded up to the os page size and clamped to the capacity.
+template<std::size_t StepB = static_cast<std::size_t> ( 1'600 * 65'536 )> // 100MB
+struct linear_growth {
+    [[nodiscard]] static constexpr std::size_t grow ( std::size_t committed_b_ ) noexcept { return committed_b_ + StepB; }
+};
+
+template<std::size_t InitialB = static_cast<std::size_t> ( 16 * 65'536 )> // 1MB
+struct geometric_growth {
+    [[nodiscard]] static constexpr std::size_t grow ( std::size_t committed_b_ ) noexcept {
+        return committed_b_ ? 2 * committed_b_ : InitialB;
+    }
 };
 
+#if defined( _MSC_VER )
+
 struct srw_lock final {
 
     srw_lock ( ) noexcept             = default;
@@ -201,6 +405,8 @@ struct srw_lock final {
     SRWLOCK handle = SRWLOCK_INIT;
 };
 
+#endif
+
 // This mutex handles the in-flight problem (at zero cost).
 struct vm_vector_spin_mutex final {
 
@@ -267,10 +473,14 @@ struct /* alignas ( 16 ) */ vm_aligner : public Data {
 } // namespace vm_vector
 } // namespace detail
 
-template<typename ValueType, std::size_t Capacity>
+template<typename ValueType, std::size_t Capacity, bool HugePages = false>
 struct vm_concurrent_vector {
 
-    using is_windows = std::integral_constant<bool, static_cast<bool> ( _MSC_VER )>; // ?
+#if defined( _MSC_VER )
+    using is_windows = std::true_type;
+#else
+    using is_windows = std::false_type;
+#endif
 
     static constexpr std::size_t thread_reserve_size = 32;
 
@@ -294,10 +504,11 @@ struct vm_concurrent_vector {
     // using mutex = detail::vm_vector::srw_lock;
     using mutex = detail::vm_vector::vm_vector_spin_mutex;
 
-    using vm = detail::vm_vector::vm<pointer>;
+    using vm = detail::vm_vector::vm<pointer, HugePages>;
 
+    // The chunk [ begin, end ) a thread appends to.
     struct thread_local_data {
-        pointer begin              = nullptr;
+        pointer begin = nullptr, end = nullptr;
         std::size_t reserve_size_b = 2 * thread_reserve_size * sizeof ( value_type );
     };
 
@@ -325,6 +536,7 @@ struct vm_concurrent_vector {
     }
 
     ~vm_concurrent_vector ( ) {
+        stop_prefault ( );
         recycle_colony ( );
         if constexpr ( not std::is_trivial<value_type>::value )
             for ( value_type & v : *this )
@@ -341,36 +553,73 @@ struct vm_concurrent_vector {
     }
     [[nodiscard]] constexpr size_type max_size ( ) const noexcept { return capacity ( ); }
 
+    // Number of committed bytes backed by huge pages (reads /proc/self/smaps on Linux).
+    [[nodiscard]] std::size_t huge_b ( ) const noexcept { return m_vm.huge_b ( m_begin ); }
+
+    // Per NUMA node, the bytes in slabs, in chunks handed to threads, and in slabs bound to the node.
+    struct numa_usage {
+        std::size_t slabs_b = 0, chunks_b = 0, bound_b = 0;
+    };
+
+    struct numa_slab {
+        pointer next = nullptr, end = nullptr;
+        numa_usage usage;
+    };
+
+    // Not thread-safe. With slab_b_ > 0, threads take their chunks from a slab (of at least slab_b_ bytes, carved
+    // from the end) of the NUMA node they run on, whose pages are placed on that node, 0 turns it off.
+    void numa_slabs ( std::size_t slab_b_ ) noexcept {
+        m_numa_slab_b = slab_b_ ? detail::round_multiple ( slab_b_, vm::page_size_b ) : 0;
+        for ( numa_slab & slab : m_numa_slabs )
+            slab.next = slab.end = nullptr;
+    }
+
+    // thread-safe!
+    [[nodiscard]] numa_usage numa_node_usage ( unsigned node_ ) const noexcept {
+        std::lock_guard lock ( m_end_mutex );
+        return m_numa_slabs[ node_ % detail::numa_max_nodes ].usage;
+    }
+
+    // Not thread-safe. Starts a thread that commits and faults in memory ahead of use, keeping (at least) ahead_b_
+    // bytes beyond the end committed, the appending threads then don't fault (unless they outrun it, in which case
+    // they commit (and fault in) themselves, as without it).
+    void start_prefault ( std::size_t ahead_b_ = alloc_page_size_b ) {
+        stop_prefault ( );
+        m_prefault_ahead_b = round_alloc_page_size_b ( std::max ( ahead_b_, std::size_t{ 1 } ) );
+        m_prefault_stop    = false;
+        m_prefault_thread  = std::thread{ [ this ] { prefault ( ); } };
+        request_prefault ( );
+    }
+    // Not thread-safe.
+    void stop_prefault ( ) noexcept {
+        if ( not m_prefault_thread.joinable ( ) )
+            return;
+        {
+            std::lock_guard lock ( m_prefault_mutex );
+            m_prefault_stop = true;
+        }
+        m_prefault_cv.notify_one ( );
+        m_prefault_thread.join ( );
+        m_prefault_ahead_b = 0;
+    }
+
     // thread-safe!
     template<typename... Args>
     [[maybe_unused]] reference emplace_back ( Args &&... value_ ) {
 
-        auto next = [ = ] ( pointer p, std::size_t trs ) {
-            return reinterpret_cast<pointer> ( ( ( reinterpret_cast<std::size_t> ( p ) + trs ) / trs ) * trs );
-        };
-
         thread_local_data & tld = get_thread_local_data ( );
 
-        if ( HEDLEY_PREDICT ( not static_cast<bool> ( reinterpret_cast<std::size_t> ( tld.begin ) & ( tld.reserve_size_b - 1 ) ),
-                              true,
+        if ( HEDLEY_PREDICT ( tld.begin == tld.end, true,
                               1.0 / ( static_cast<double> ( thread_reserve_size ) / 2.0 ) ) ) { // has tld.begin reached its end.
             if ( m_end_mutex.try_lock ( ) ) {
                 // tld.reserve_size_b >>= 1;
                 std::lock_guard lock ( m_end_mutex, std::adopt_lock );
-                tld.begin = std::exchange ( m_end, next ( m_end, tld.reserve_size_b ) );
-                if ( HEDLEY_PREDICT ( m_end >= m_begin + m_vm.committed, false,
-                                      1.0 - static_cast<double> ( sizeof ( value_type ) ) /
-                                                static_cast<double> ( alloc_page_size_b ) ) )
-                    grow_allocated_by ( alloc_page_size_b );
+                reserve_chunk ( tld );
             }
             else {
                 tld.reserve_size_b <<= 1;
                 std::lock_guard lock ( m_end_mutex );
-                tld.begin = std::exchange ( m_end, next ( m_end, tld.reserve_size_b ) );
-                if ( HEDLEY_PREDICT ( m_end >= m_begin + m_vm.committed, false,
-                                      1.0 - static_cast<double> ( sizeof ( value_type ) ) /
-                                                static_cast<double> ( alloc_page_size_b ) ) )
-                    grow_allocated_by ( alloc_page_size_b );
+                reserve_chunk ( tld );
             }
         }
         return *new ( tld.begin++ ) value_type{ std::forward<Args> ( value_ )... };
@@ -508,26 +757,136 @@ struct vm_concurrent_vector {
         }
     }
 
-    void grow_allocated_by ( std::size_t size_ ) { m_vm.allocate ( m_begin, size_ ); }
+    // Hands out (under m_end_mutex) a chunk of tld_.reserve_size_b bytes (a multiple of the size of value_type), from
+    // the end, or from the slab of the node the thread runs on.
+    void reserve_chunk ( thread_local_data & tld_ ) {
+        std::size_t const chunk_size = tld_.reserve_size_b / sizeof ( value_type );
+        if ( HEDLEY_LIKELY ( not m_numa_slab_b ) ) {
+            tld_.begin = std::exchange ( m_end, m_end + chunk_size );
+            tld_.end   = m_end;
+            grow_allocated_to_end ( );
+            return;
+        }
+        unsigned const node = detail::current_numa_node ( );
+        numa_slab & slab    = m_numa_slabs[ node ];
+        if ( HEDLEY_UNLIKELY ( not slab.next or chunk_size > static_cast<std::size_t> ( slab.end - slab.next ) ) )
+            new_numa_slab ( slab, node, tld_.reserve_size_b );
+        tld_.begin = std::exchange ( slab.next, slab.next + chunk_size );
+        tld_.end   = slab.next;
+        slab.usage.chunks_b += tld_.reserve_size_b;
+    }
+
+    // Carves a slab from the end, the remainder of the old one is lost. The pages, from the first page boundary at or
+    // after the end, are bound to the node, the slab holds the whole elements in those (at least reserve_size_b_
+    // bytes' worth), the elements stay on the grid of the vector.
+    HEDLEY_NEVER_INLINE void new_numa_slab ( numa_slab & slab_, unsigned node_, std::size_t reserve_size_b_ ) {
+        std::size_t const begin_b = detail::round_multiple ( size_b ( ), vm::page_size_b );
+        std::size_t const size    =
+            detail::round_multiple ( std::max ( m_numa_slab_b, reserve_size_b_ + 2 * sizeof ( value_type ) ), vm::page_size_b );
+        m_end                     = m_begin + ( begin_b + size ) / sizeof ( value_type );
+        grow_allocated_to_end ( ); // commit before binding, a huge page commit re-maps.
+        slab_.next = m_begin + ( begin_b + sizeof ( value_type ) - 1 ) / sizeof ( value_type );
+        slab_.end  = m_end;
+        slab_.usage.slabs_b += size;
+        if ( detail::bind_numa_node ( reinterpret_cast<char *> ( m_begin ) + begin_b, size, node_ ) )
+            slab_.usage.bound_b += size;
+    }
+
+    void grow_allocated_by ( std::size_t size_ ) {
+        std::lock_guard lock ( m_commit_mutex );
+        commit ( size_ );
+    }
+
+    // Commits (with m_vm.committed under m_commit_mutex) size_ bytes, faulted in, if prefaulting, and publishes them.
+    void commit ( std::size_t size_ ) {
+        m_vm.allocate ( m_begin, size_ );
+        if ( m_prefault_ahead_b )
+            vm::populate ( reinterpret_cast<char *> ( m_begin ) + m_vm.committed - size_, size_ );
+        m_committed_b.store ( m_vm.committed, std::memory_order_release );
+    }
+
+    // Commits (under m_end_mutex) up to m_end, committed is in bytes, a reservation can span more than one step.
+    void grow_allocated_to_end ( ) {
+        if ( HEDLEY_PREDICT ( size_b ( ) > m_committed_b.load ( std::memory_order_acquire ), false,
+                              1.0 - static_cast<double> ( sizeof ( value_type ) ) / static_cast<double> ( alloc_page_size_b ) ) ) {
+            std::lock_guard lock ( m_commit_mutex ); // the prefault thread might have got there meanwhile.
+            while ( size_b ( ) > m_vm.committed )
+                commit ( alloc_page_size_b );
+        }
+        if ( m_prefault_ahead_b and size_b ( ) + m_prefault_ahead_b > m_prefault_target_b.load ( std::memory_order_relaxed ) )
+            request_prefault ( );
+    }
+
+    // Moves the prefault target on by (at least) a step, which makes the (rare) locking once per step.
+    void request_prefault ( ) {
+        {
+            std::lock_guard lock ( m_prefault_mutex );
+            m_prefault_target_b.store ( std::min ( round_alloc_page_size_b ( size_b ( ) + m_prefault_ahead_b ), capacity_b ( ) ),
+                                        std::memory_order_relaxed );
+        }
+        m_prefault_cv.notify_one ( );
+    }
+
+    void prefault ( ) {
+        std::unique_lock lock ( m_prefault_mutex );
+        while ( true ) {
+            m_prefault_cv.wait ( lock, [ this ] {
+                return m_prefault_stop or m_prefault_target_b.load ( std::memory_order_relaxed ) >
+                                              m_committed_b.load ( std::memory_order_relaxed );
+            } );
+            if ( m_prefault_stop )
+                return;
+            std::size_t const target = m_prefault_target_b.load ( std::memory_order_relaxed );
+            lock.unlock ( );
+            try {
+                std::lock_guard commit_lock ( m_commit_mutex );
+                while ( m_vm.committed < target )
+                    commit ( alloc_page_size_b );
+            }
+            catch ( std::bad_alloc const & ) {
+                // Leave it to the appending threads, which will throw.
+                lock.lock ( );
+                m_prefault_target_b.store ( 0, std::memory_order_relaxed );
+                continue;
+            }
+            lock.lock ( );
+        }
+    }
 
     thread_local_data_colony & m_thread_local_data_colony;
     vm m_vm;
     pointer m_begin, m_end;
     alignas ( 64 ) mutex m_end_mutex;
+
+    // The committed (and, if prefaulting, faulted in) bytes, m_vm.committed is guarded by m_commit_mutex.
+    alignas ( 64 ) std::atomic<std::size_t> m_committed_b = { 0 };
+    std::mutex m_commit_mutex;
+
+    std::size_t m_prefault_ahead_b = 0; // 0, not prefaulting.
+    std::atomic<std::size_t> m_prefault_target_b = { 0 };
+    bool m_prefault_stop = false;
+    std::mutex m_prefault_mutex;
+    std::condition_variable m_prefault_cv;
+    std::thread m_prefault_thread;
+
+    std::size_t m_numa_slab_b = 0; // 0, no slabs.
+    numa_slab m_numa_slabs[ detail::numa_max_nodes ];
 }; // namespace sax
 
-template<typename ValueType, std::size_t Capacity>
-alignas ( 64 )
-    typename vm_concurrent_vector<ValueType, Capacity>::mutex vm_concurrent_vector<ValueType, Capacity>::s_this_map_mutex;
-template<typename ValueType, std::size_t Capacity>
-alignas ( 64 ) typename vm_concurrent_vector<ValueType, Capacity>::mutex vm_concurrent_vector<ValueType, Capacity>::s_thread_mutex;
-template<typename ValueType, std::size_t Capacity>
-typename vm_concurrent_vector<ValueType, Capacity>::thread_local_data_map vm_concurrent_vector<ValueType, Capacity>::s_this_map;
-template<typename ValueType, std::size_t Capacity>
-typename vm_concurrent_vector<ValueType, Capacity>::thread_local_data_colony_vector
-    vm_concurrent_vector<ValueType, Capacity>::s_freelist;
-
-template<typename ValueType, std::size_t Capacity>
+template<typename ValueType, std::size_t Capacity, bool HugePages>
+alignas ( 64 ) typename vm_concurrent_vector<ValueType, Capacity, HugePages>::mutex
+    vm_concurrent_vector<ValueType, Capacity, HugePages>::s_this_map_mutex;
+template<typename ValueType, std::size_t Capacity, bool HugePages>
+alignas ( 64 ) typename vm_concurrent_vector<ValueType, Capacity, HugePages>::mutex
+    vm_concurrent_vector<ValueType, Capacity, HugePages>::s_thread_mutex;
+template<typename ValueType, std::size_t Capacity, bool HugePages>
+typename vm_concurrent_vector<ValueType, Capacity, HugePages>::thread_local_data_map
+    vm_concurrent_vector<ValueType, Capacity, HugePages>::s_this_map;
+template<typename ValueType, std::size_t Capacity, bool HugePages>
+typename vm_concurrent_vector<ValueType, Capacity, HugePages>::thread_local_data_colony_vector
+    vm_concurrent_vector<ValueType, Capacity, HugePages>::s_freelist;
+
+template<typename ValueType, std::size_t Capacity, typename Growth = detail::vm_vector::linear_growth<>, bool HugePages = false>
 struct vm_vector {
 
     using value_type = ValueType;
@@ -547,9 +906,11 @@ struct vm_vector {
     using reverse_iterator       = pointer;
     using const_reverse_iterator = const_pointer;
 
-    vm_vector ( ) :
-        m_begin{ reinterpret_cast<pointer> ( VirtualAlloc ( nullptr, capacity_b ( ), MEM_RESERVE, PAGE_READWRITE ) ) },
-        m_end{ m_begin }, committed{ 0 } {
+    using growth_policy = Growth;
+
+    using vm = detail::vm_vector::vm<pointer, HugePages>;
+
+    vm_vector ( ) : m_vm{ }, m_begin{ m_vm.reserve ( capacity_b ( ) ) }, m_end{ m_begin } {
         if ( HEDLEY_UNLIKELY ( not m_begin ) )
             throw std::bad_alloc ( );
     };
@@ -560,10 +921,8 @@ struct vm_vector {
     }
 
     explicit vm_vector ( size_type const s_, value_type const & v_ ) : vm_vector{ } {
-        size_type rc = required_b ( s_ );
-        if ( HEDLEY_UNLIKELY ( not VirtualAlloc ( m_end, rc, MEM_COMMIT, PAGE_READWRITE ) ) )
-            throw std::bad_alloc ( );
-        committed = rc;
+        if ( size_type const rc = std::min ( required_b ( s_ ), capacity_b ( ) ); rc )
+            m_vm.allocate ( m_begin, rc );
         for ( pointer e = m_begin + std::min ( s_, capacity ( ) ); m_end < e; ++m_end )
             new ( m_end ) value_type{ v_ };
     }
@@ -574,9 +933,8 @@ struct vm_vector {
                 v.~value_type ( );
         }
         if ( HEDLEY_LIKELY ( m_begin ) ) {
-            VirtualFree ( m_begin, capacity_b ( ), MEM_RELEASE );
+            m_vm.free ( m_begin, capacity_b ( ) );
             m_end = m_begin = nullptr;
-            committed       = 0;
         }
     }
 
@@ -584,16 +942,16 @@ struct vm_vector {
     [[nodiscard]] size_type size ( ) const noexcept {
         return reinterpret_cast<value_type *> ( m_end ) - reinterpret_cast<value_type *> ( m_begin );
     }
+    // Number of bytes backed by memory.
+    [[nodiscard]] size_type committed_b ( ) const noexcept { return m_vm.committed; }
+    // Number of committed bytes backed by huge pages (reads /proc/self/smaps on Linux).
+    [[nodiscard]] size_type huge_b ( ) const noexcept { return m_vm.huge_b ( m_begin ); }
     [[nodiscard]] constexpr size_type max_size ( ) const noexcept { return capacity ( ); }
 
     template<typename... Args>
     [[maybe_unused]] reference emplace_back ( Args &&... value_ ) {
-        if ( HEDLEY_UNLIKELY ( size_b ( ) == committed ) ) {
-            size_type cib = std::min ( committed ? grow ( committed ) : alloc_page_size_b, capacity_b ( ) );
-            if ( HEDLEY_UNLIKELY ( not VirtualAlloc ( m_end, cib - committed, MEM_COMMIT, PAGE_READWRITE ) ) )
-                throw std::bad_alloc ( );
-            committed = cib;
-        }
+        if ( HEDLEY_UNLIKELY ( size_b ( ) + sizeof ( value_type ) > m_vm.committed ) ) // the step need not be a multiple.
+            grow_allocated ( );
         return *new ( m_end++ ) value_type{ std::forward<Args> ( value_ )... };
     }
     [[maybe_unused]] reference push_back ( const_reference value_ ) { return emplace_back ( value_type{ value_ } ); }
@@ -659,8 +1017,7 @@ struct vm_vector {
     }
 
     private:
-    static constexpr size_type os_vm_page_size_b = static_cast<size_type> ( 65'536 );         // 64KB
-    static constexpr size_type alloc_page_size_b = static_cast<size_type> ( 1'600 * 65'536 ); // 100MB
+    static constexpr size_type os_vm_page_size_b = vm::page_size_b; // 64KB, or 2MB
 
     [[nodiscard]] size_type required_b ( size_type const & r_ ) const noexcept {
         std::size_t req = static_cast<std::size_t> ( r_ ) * sizeof ( value_type );
@@ -674,11 +1031,16 @@ struct vm_vector {
         return static_cast<size_type> ( reinterpret_cast<char *> ( m_end ) - reinterpret_cast<char *> ( m_begin ) );
     }
 
-    [[nodiscard]] HEDLEY_PURE size_type grow ( size_type const & cap_b_ ) const noexcept { return cap_b_ + alloc_page_size_b; }
-    [[nodiscard]] HEDLEY_PURE size_type shrink ( size_type const & cap_b_ ) const noexcept { return cap_b_ - alloc_page_size_b; }
+    HEDLEY_NEVER_INLINE void grow_allocated ( ) {
+        size_type const cib =
+            std::min ( detail::round_multiple ( growth_policy::grow ( m_vm.committed ), os_vm_page_size_b ), capacity_b ( ) );
+        if ( HEDLEY_UNLIKELY ( cib < size_b ( ) + sizeof ( value_type ) ) ) // full.
+            throw std::bad_alloc ( );
+        m_vm.allocate ( m_begin, cib - m_vm.committed );
+    }
 
+    vm m_vm;
     pointer m_begin, m_end;
-    size_type committed;
 };
 
 } // namespace sax
@@ -25,6 +25,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 
 // #include <gfx/timsort.hpp> // For faster sorting in plf::colony.
 
@@ -32,11 +33,20 @@
 
 #include "vm_backed.hpp"
 #include "rooted_tree.hpp"
+#include "mapped_rooted_tree.hpp"
+#include "packed_rooted_tree.hpp"
+#include "ancestor_index.hpp"
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <filesystem>
+#include <functional>
 #include <jthread>
 #include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <type_traits>
 
 #include <plf/plf_nanotimer.h>
@@ -109,24 +119,803 @@ using SequentailTree = sax::rooted_tree<Foo>;
 
 template<typename Tree>
 void add_nodes_high_workload ( Tree & tree_, int n_ ) {
+    sax::Rng & generator = Rng::generator ( ); // Of this thread.
     for ( int i = 1; i < n_; ++i ) {
         // Some piecewise distibution, simulating more 'normal' use case, where new nodes are added more often at
         // the bottom. It is also **very** expensive to calculate, so gives some sensible workload, which helps
         // to get a better idea of performance, as contention is much lower (like in real use cases) as compared
         // to add_nodes_low_work_load().
-        auto back                         = tree_.nodes.size ( );
+        auto back                         = tree_.published_size ( );
         std::array<float, 4> ai           = { 1.0f, back / 2.0f, 2 * back / 3.0f, static_cast<float> ( back - 1 ) };
         constexpr std::array<float, 3> aw = { 1, 3, 9 };
-        int n = static_cast<int> ( std::piecewise_constant_distribution<float> ( ai.begin ( ), ai.end ( ), aw.begin ( ) ) ( rng ) );
-        tree_.emplace ( sax::nid{ n }, i );
+        std::piecewise_constant_distribution<float> dis ( ai.begin ( ), ai.end ( ), aw.begin ( ) );
+        typename Tree::nid n;
+        do // The published nids include the ones reserved (and not yet linked) by other threads.
+            n = typename Tree::nid{ static_cast<typename Tree::index_type> ( dis ( generator ) ) };
+        while ( not tree_.is_linked ( n ) );
+        tree_.emplace ( n, i );
     }
 }
 
 template<typename Tree>
 void add_nodes_low_workload ( Tree & tree_, int n_ ) {
-    for ( int i = 1; i < n_; ++i )
-        tree_.emplace ( sax::nid{ sax::uniform_int_distribution<int> ( 1, static_cast<int> ( tree_.nodes.size ( ) ) - 1 ) ( rng ) },
-                        i );
+    sax::Rng & generator = Rng::generator ( ); // Of this thread.
+    for ( int i = 1; i < n_; ++i ) {
+        sax::uniform_int_distribution<int> dis ( 1, static_cast<int> ( tree_.published_size ( ) ) - 1 );
+        typename Tree::nid n;
+        do // The published nids include the ones reserved (and not yet linked) by other threads.
+            n = typename Tree::nid{ static_cast<typename Tree::index_type> ( dis ( generator ) ) };
+        while ( not tree_.is_linked ( n ) );
+        tree_.emplace ( n, i );
+    }
+}
+
+// Checks, each one aborts (also in release builds) on failure.
+
+void check ( bool condition_, char const * what_ ) {
+    if ( not condition_ ) {
+        std::cout << "check failed: " << what_ << nl << std::flush; // abort ( ) does not flush.
+        std::abort ( );
+    }
+}
+
+template<typename Tree>
+[[nodiscard]] int count_depth_first ( Tree const & tree_ ) {
+    int count = 0;
+    for ( typename Tree::const_depth_iterator it{ tree_ }; it.is_valid ( ); ++it )
+        count += 1;
+    return count;
+}
+
+// Concurrent inserts, only linked nodes are picked as parents, no node is lost.
+void check_concurrent_insert ( ) {
+    ConcurrentTree tree ( 1 );
+    check ( tree.is_linked ( tree.root ) and not tree.is_linked ( tree.invalid ), "the root is linked" );
+    std::vector<std::thread> threads;
+    for ( int n = 0; n < 4; ++n )
+        threads.emplace_back ( add_nodes_low_workload<ConcurrentTree>, std::ref ( tree ), 10'001 );
+    for ( std::thread & t : threads )
+        t.join ( );
+    check ( count_depth_first ( tree ) == 1 + 4 * 10'000, "all concurrently inserted nodes are reachable" );
+}
+
+// Concurrent inserts under a single parent, the CAS on its tail loses no sibling.
+void check_concurrent_siblings ( ) {
+    ConcurrentTree tree ( 1 );
+    std::vector<std::thread> threads;
+    for ( int n = 0; n < 4; ++n )
+        threads.emplace_back ( [ &tree ] ( ) {
+            for ( int i = 1; i <= 1'000; ++i )
+                tree.emplace ( tree.root, i );
+        } );
+    for ( std::thread & t : threads )
+        t.join ( );
+    int count = 0;
+    for ( ConcurrentTree::const_out_iterator it{ tree, tree.root }; it.is_valid ( ); ++it )
+        count += 1;
+    check ( 4'000 == count and 4'000 == tree.hook ( tree.root ).fan, "all concurrently inserted siblings are linked" );
+}
+
+// A reader, concurrent with the writers, only finds constructed nodes that lead up to the root.
+void check_concurrent_publish ( ) {
+    ConcurrentTree tree ( 1 );
+    std::atomic<bool> done = false;
+    int bad = 0, seen = 0;
+    std::thread reader ( [ & ] ( ) {
+        sax::Rng & generator = Rng::generator ( ); // Of this thread.
+        while ( not done.load ( ) or not seen ) {
+            sax::nid n{ sax::uniform_int_distribution<int> ( 1, static_cast<int> ( tree.published_size ( ) ) - 1 ) ( generator ) };
+            if ( not tree.is_linked ( n ) )
+                continue;
+            seen += 1;
+            if ( not tree[ n ].value )
+                bad += 1;
+            while ( tree.hook ( n ).up.is_valid ( ) )
+                n = tree.hook ( n ).up;
+            if ( tree.root != n )
+                bad += 1;
+        }
+    } );
+    std::vector<std::thread> writers;
+    for ( int n = 0; n < 4; ++n )
+        writers.emplace_back ( add_nodes_low_workload<ConcurrentTree>, std::ref ( tree ), 10'001 );
+    for ( std::thread & t : writers )
+        t.join ( );
+    done = true;
+    reader.join ( );
+    check ( seen and not bad, "a linked node is constructed and linked up to the root" );
+}
+
+// An erased sub-tree is unlinked, and its nids are recycled by the following insertions.
+void check_erase_subtree ( ) {
+    SequentailTree tree ( 1 );
+    sax::nid a = tree.emplace ( tree.root, 2 );
+    tree.emplace ( a, 3 );
+    tree.emplace ( a, 4 );
+    sax::nid d             = tree.emplace ( tree.root, 5 );
+    std::size_t const size = tree.nodes.size ( );
+    tree.erase_subtree ( a );
+    check ( 2 == count_depth_first ( tree ) and 1 == tree.hook ( tree.root ).fan, "an erased sub-tree is unlinked" );
+    for ( int i = 6; i < 9; ++i )
+        tree.emplace ( d, i );
+    check ( 5 == count_depth_first ( tree ) and size == tree.nodes.size ( ), "the nids of an erased sub-tree are recycled" );
+}
+
+// Rerooting keeps the sub-tree only, densely packed, with its root as the root-node.
+void check_reroot ( ) {
+    SequentailTree tree ( 1 );
+    sax::nid a = tree.emplace ( tree.root, 2 );
+    tree.emplace ( a, 3 );
+    tree.emplace ( a, 4 );
+    sax::nid d = tree.emplace ( tree.root, 5 );
+    auto map   = tree.reroot ( a );
+    check ( 3 == count_depth_first ( tree ) and 4 == tree.nodes.size ( ), "a rerooted tree only holds the sub-tree" );
+    check ( 2 == tree[ tree.root ].value and tree.hook ( tree.root ).up.is_invalid ( ), "the sub-tree root is the root-node" );
+    check ( tree.root == map[ a.id ] and map[ d.id ].is_invalid ( ), "the nid map of reroot" );
+}
+
+template<typename Tree>
+[[nodiscard]] long long sum_values ( Tree const & tree_ ) {
+    long long sum = 0;
+    for ( typename Tree::const_depth_iterator it{ tree_ }; it.is_valid ( ); ++it )
+        sum += it->value;
+    return sum;
+}
+
+// After a relayout, the matching traversal visits the nids in order, the tree is unchanged otherwise.
+void check_relayout ( ) {
+    SequentailTree tree ( 1 );
+    add_nodes_low_workload ( tree, 1'000 );
+    long long const sum = sum_values ( tree );
+    tree.relayout ( sax::node_order::depth_first );
+    int i = 1;
+    bool ordered = true;
+    for ( SequentailTree::const_depth_iterator it{ tree }; it.is_valid ( ); ++it )
+        ordered = ordered and i++ == it.id ( ).id;
+    check ( ordered and 1'000 == i - 1, "depth-first relayout" );
+    tree.relayout ( sax::node_order::breadth_first );
+    i = 1;
+    for ( SequentailTree::const_breadth_iterator it{ tree }; it.is_valid ( ); ++it )
+        ordered = ordered and i++ == it.id ( ).id;
+    check ( ordered and 1'000 == i - 1, "breadth-first relayout" );
+    tree.relayout ( sax::node_order::van_emde_boas );
+    check ( 1'000 == count_depth_first ( tree ) and sum == sum_values ( tree ), "van Emde Boas relayout" );
+}
+
+// A payload without a hook base gets its hooks in a parallel array.
+void check_split_hooks ( ) {
+    using SplitTree           = sax::rooted_tree<int>;
+    using ConcurrentSplitTree = sax::concurrent_rooted_tree<int>;
+    static_assert ( SplitTree::is_split::value and ConcurrentSplitTree::is_split::value );
+    SplitTree tree ( 1 );
+    sax::nid a = tree.emplace ( tree.root, 2 );
+    tree.emplace ( a, 3 );
+    check ( 3 == count_depth_first ( tree ) and 3 == tree[ tree.hook ( a ).tail ], "split hooks" );
+    check ( tree.nodes.size ( ) == tree.hooks.size ( ), "split hooks are parallel to the nodes" );
+    ConcurrentSplitTree ctree ( 1 );
+    std::vector<std::thread> threads;
+    for ( int n = 0; n < 4; ++n )
+        threads.emplace_back ( [ &ctree ] ( ) {
+            for ( int i = 1; i <= 1'000; ++i )
+                ctree.emplace ( ctree.root, i );
+        } );
+    for ( std::thread & t : threads )
+        t.join ( );
+    check ( 4'001 == count_depth_first ( ctree ) and ctree.nodes.size ( ) == ctree.hooks.size ( ), "concurrent split hooks" );
+}
+
+// The iterators given a scratch buffer visit the same nodes as those without.
+void check_scratch_iterators ( ) {
+    SequentailTree tree ( 1 );
+    add_nodes_low_workload ( tree, 1'000 );
+    SequentailTree::id_vector scratch;
+    int depth = 0, breadth = 0, internal = 0, leaf = 0;
+    for ( SequentailTree::const_depth_iterator it{ tree, scratch }; it.is_valid ( ); ++it )
+        depth += 1;
+    for ( SequentailTree::const_breadth_iterator it{ tree, scratch }; it.is_valid ( ); ++it )
+        breadth += 1;
+    for ( SequentailTree::const_internal_iterator it{ tree, scratch }; it.is_valid ( ); ++it )
+        internal += 1;
+    for ( SequentailTree::const_leaf_iterator it{ tree, scratch }; it.is_valid ( ); ++it )
+        leaf += 1;
+    check ( 1'000 == depth and 1'000 == breadth and 1'000 == internal + leaf, "iterators with a scratch buffer" );
+}
+
+// The stackless iterators visit all nodes, pre-order parents before, post-order parents after their children.
+void check_stackless_iterators ( ) {
+    SequentailTree tree ( 1 );
+    add_nodes_low_workload ( tree, 1'000 );
+    std::vector<bool> visited ( tree.nodes.size ( ) );
+    int count = 0;
+    bool ordered = true;
+    for ( SequentailTree::const_pre_order_iterator it{ tree }; it.is_valid ( ); ++it, ++count ) {
+        sax::nid up = tree.hook ( it.id ( ) ).up;
+        ordered     = ordered and ( up.is_invalid ( ) or visited[ up.id ] );
+        visited[ it.id ( ).id ] = true;
+    }
+    check ( ordered and 1'000 == count, "pre-order iterator" );
+    visited.assign ( visited.size ( ), false );
+    count = 0;
+    for ( SequentailTree::const_post_order_iterator it{ tree }; it.is_valid ( ); ++it, ++count ) {
+        sax::nid up = tree.hook ( it.id ( ) ).up;
+        ordered     = ordered and ( up.is_invalid ( ) or not visited[ up.id ] );
+        visited[ it.id ( ).id ] = true;
+    }
+    check ( ordered and 1'000 == count, "post-order iterator" );
+}
+
+// The parallel visits reach every node once, a chain as well as a bushy tree, and every leaf.
+void check_parallel_for_each ( ) {
+    SequentailTree chain ( 1 ), bushy ( 1 );
+    sax::nid n = chain.root;
+    for ( int i = 2; i <= 100'000; ++i )
+        n = chain.emplace ( n, i );
+    add_nodes_low_workload ( bushy, 100'000 );
+    for ( SequentailTree * tree : { &chain, &bushy } ) {
+        std::atomic<long long> sum = 0;
+        std::atomic<int> leaves    = 0;
+        sax::parallel_for_each ( *tree, tree->root, [ &sum ] ( Foo const & node_ ) { sum += node_.value; } );
+        sax::parallel_for_each_leaf ( *tree, tree->root, [ &leaves ] ( Foo const & ) { leaves += 1; } );
+        int count = 0;
+        for ( SequentailTree::const_leaf_iterator it{ *tree }; it.is_valid ( ); ++it )
+            count += 1;
+        check ( sum_values ( *tree ) == sum and count == leaves, "parallel_for_each ( _leaf )" );
+    }
+}
+
+// The height and the widths of the levels, with a level wider than the grain size (expanded in parallel).
+void check_height ( ) {
+    SequentailTree tree ( 1 );
+    for ( int i = 0; i < 10'000; ++i ) {
+        sax::nid n = tree.emplace ( tree.root, i );
+        if ( i < 10 )
+            for ( int j = 0; j < 3; ++j )
+                tree.emplace ( n, j );
+    }
+    SequentailTree::size_type width;
+    std::vector<SequentailTree::size_type> widths;
+    check ( 3 == tree.height ( tree.root, &width ) and 10'000 == width, "height and width" );
+    check ( 3 == tree.height ( tree.root, widths ) and std::vector<SequentailTree::size_type>{ 1, 10'000, 30 } == widths,
+            "the widths of the levels" );
+}
+
+// The sub-tree sizes by reduce_up, of a chain and of a bushy tree, match those of a serial post-order walk.
+void check_reduce_up ( ) {
+    SequentailTree chain ( 1 ), bushy ( 1 );
+    sax::nid n = chain.root;
+    for ( int i = 2; i <= 100'000; ++i )
+        n = chain.emplace ( n, i );
+    add_nodes_low_workload ( bushy, 100'000 );
+    for ( SequentailTree * tree : { &chain, &bushy } ) {
+        std::vector<int> sizes ( tree->nodes.size ( ) ), expected ( tree->nodes.size ( ) );
+        sax::reduce_up (
+            *tree, tree->root, [] ( Foo const & ) { return 1; }, [] ( int a_, int b_ ) { return a_ + b_; }, sizes );
+        for ( SequentailTree::const_post_order_iterator it{ *tree }; it.is_valid ( ); ++it ) {
+            expected[ it.id ( ).id ] += 1;
+            if ( sax::nid up = tree->hook ( it.id ( ) ).up; up.is_valid ( ) )
+                expected[ up.id ] += expected[ it.id ( ).id ];
+        }
+        check ( 100'000 == sizes[ tree->root.id ] and expected == sizes, "reduce_up" );
+    }
+}
+
+// The depths by propagate_down, of a chain and of a bushy tree, match those of a serial pre-order walk.
+void check_propagate_down ( ) {
+    SequentailTree chain ( 1 ), bushy ( 1 );
+    sax::nid n = chain.root;
+    for ( int i = 2; i <= 100'000; ++i )
+        n = chain.emplace ( n, i );
+    add_nodes_low_workload ( bushy, 100'000 );
+    for ( SequentailTree * tree : { &chain, &bushy } ) {
+        std::vector<int> depths ( tree->nodes.size ( ) ), expected ( tree->nodes.size ( ) );
+        sax::propagate_down (
+            *tree, tree->root, 0, [] ( Foo const &, int depth_ ) { return depth_ + 1; }, depths );
+        for ( SequentailTree::const_pre_order_iterator it{ *tree }; it.is_valid ( ); ++it )
+            if ( sax::nid up = tree->hook ( it.id ( ) ).up; up.is_valid ( ) )
+                expected[ it.id ( ).id ] = expected[ up.id ] + 1;
+        check ( expected == depths, "propagate_down" );
+        check ( tree != &chain or 99'999 == depths[ n.id ], "propagate_down along a chain" );
+    }
+}
+
+// Overwrites the bytes at offset_ of the file at path_ with those of value_.
+template<typename T>
+void patch_file ( std::string const & path_, long offset_, T const & value_ ) {
+    std::FILE * file = std::fopen ( path_.c_str ( ), "r+b" );
+    std::fseek ( file, offset_, SEEK_SET );
+    std::fwrite ( &value_, sizeof ( value_ ), 1, file );
+    std::fclose ( file );
+}
+
+template<typename Tree>
+[[nodiscard]] bool opens ( std::string const & path_ ) {
+    try {
+        Tree tree ( path_.c_str ( ) );
+        return true;
+    }
+    catch ( std::runtime_error const & ) {
+        return false;
+    }
+}
+
+// A mapped tree reads back as written, an empty one as well, a file with bad offsets, links, cycles or an overflowing
+// size is rejected.
+void check_mapped ( ) {
+    using MappedTree       = sax::mapped_rooted_tree<Foo>;
+    std::string const path = ( std::filesystem::temp_directory_path ( ) / "rooted_tree_check.bin" ).string ( );
+    SequentailTree tree ( 1 );
+    add_nodes_low_workload ( tree, 1'000 );
+    sax::write_mapped ( tree, path.c_str ( ) );
+    {
+        MappedTree mapped ( path.c_str ( ) );
+        SequentailTree::const_pre_order_iterator a{ tree };
+        MappedTree::const_pre_order_iterator b{ mapped };
+        bool equal = tree.nodes.size ( ) == static_cast<std::size_t> ( mapped.size ( ) );
+        for ( ; a.is_valid ( ) and b.is_valid ( ); ++a, ++b )
+            equal = equal and a.id ( ) == b.id ( ) and a->value == b->value;
+        check ( equal and not a.is_valid ( ) and not b.is_valid ( ), "a mapped tree reads back as written" );
+    }
+    std::uint64_t const hooks_offset = sax::detail::make_mapped_header<sax::rooted_tree_hook, Foo> ( 1'000 ).hooks_offset;
+    patch_file ( path, offsetof ( sax::detail::mapped_header, hooks_offset ), hooks_offset + 64 );
+    check ( not opens<MappedTree> ( path ), "a mapped tree with a bad offset is rejected" );
+    patch_file ( path, offsetof ( sax::detail::mapped_header, hooks_offset ), hooks_offset );
+    check ( opens<MappedTree> ( path ), "a mapped tree with a restored offset opens" );
+    long const up_offset = static_cast<long> ( hooks_offset + sizeof ( sax::rooted_tree_hook ) ); // hook ( 1 ).up.
+    patch_file ( path, up_offset, sax::nid{ 1'000'000 } );
+    check ( not opens<MappedTree> ( path ), "a mapped tree with a bad link is rejected" );
+    patch_file ( path, up_offset, tree.invalid );
+    sax::nid const child = tree.hook ( tree.root ).tail; // Made its own sibling, a cycle.
+    std::size_t const prev_offset =
+        hooks_offset + child.id * sizeof ( sax::rooted_tree_hook ) + offsetof ( sax::rooted_tree_hook, prev );
+    patch_file ( path, static_cast<long> ( prev_offset ), child );
+    check ( not opens<MappedTree> ( path ), "a mapped tree with a cycle is rejected" );
+    tree.clear ( );
+    sax::write_mapped ( tree, path.c_str ( ) );
+    check ( opens<MappedTree> ( path ) and 1 == MappedTree ( path.c_str ( ) ).size ( ), "an empty mapped tree" );
+    // A size that wraps the offsets (of 32 and 4 byte elements) around to those of the real one.
+    using WideTree       = sax::rooted_tree<int, sax::basic_rooted_tree_hook<std::int64_t>>;
+    using MappedWideTree = sax::mapped_rooted_tree<int, sax::basic_rooted_tree_hook<std::int64_t>>;
+    WideTree wide ( 1 );
+    add_nodes_low_workload ( wide, 1'000 );
+    sax::write_mapped ( wide, path.c_str ( ) );
+    check ( opens<MappedWideTree> ( path ), "a wide mapped tree" );
+    patch_file ( path, offsetof ( sax::detail::mapped_header, size ), std::uint64_t{ wide.nodes.size ( ) + ( 1ull << 62 ) } );
+    check ( not opens<MappedWideTree> ( path ), "a mapped tree with an overflowing size is rejected" );
+    std::filesystem::remove ( path );
+}
+
+// A packed tree reads back as written, with its depths rebuilt, an empty one as well.
+void check_packed ( ) {
+    using DepthTree = sax::rooted_tree<int, sax::depth_hook>;
+    DepthTree tree ( 1 ), read ( 1 );
+    sax::nid n = tree.root;
+    for ( int i = 2; i <= 1'000; ++i )
+        n = tree.emplace ( i % 3 ? n : tree.root, i );
+    std::stringstream stream;
+    sax::write_packed ( tree, stream );
+    sax::read_packed ( read, stream );
+    DepthTree::const_pre_order_iterator a{ tree }, b{ read };
+    bool equal = tree.nodes.size ( ) == read.nodes.size ( );
+    for ( ; a.is_valid ( ) and b.is_valid ( ); ++a, ++b )
+        equal = equal and a.id ( ) == b.id ( ) and *a == *b and tree.hook ( a.id ( ) ).depth == read.hook ( b.id ( ) ).depth;
+    check ( equal and not a.is_valid ( ) and not b.is_valid ( ), "a packed tree reads back" );
+    check ( tree.height ( ) == read.height ( ), "the depths of a packed tree are rebuilt" );
+    // A node that is its own parent.
+    sax::nid const child = tree.hook ( tree.root ).tail;
+    tree.hook ( child ).up = child;
+    stream.str ( { } );
+    sax::write_packed ( tree, stream );
+    bool rejected = false;
+    try {
+        sax::read_packed ( read, stream );
+    }
+    catch ( std::runtime_error const & ) {
+        rejected = true;
+    }
+    check ( rejected and 1 == read.nodes.size ( ), "a packed stream that does not hold a tree is rejected" );
+    tree.hook ( child ).up = tree.root;
+    // The width of the nids has to match.
+    sax::rooted_tree<int, sax::basic_rooted_tree_hook<std::uint16_t>> narrow ( 1 );
+    narrow.emplace ( narrow.root, 2 );
+    stream.str ( { } );
+    sax::write_packed ( tree, stream );
+    rejected = false;
+    try {
+        sax::read_packed ( narrow, stream );
+    }
+    catch ( std::runtime_error const & ) {
+        rejected = true;
+    }
+    check ( rejected and 3 == narrow.nodes.size ( ), "a packed stream of another index type is rejected" );
+    tree.clear ( );
+    stream.str ( { } );
+    sax::write_packed ( tree, stream );
+    sax::read_packed ( read, stream );
+    check ( 1 == read.nodes.size ( ), "an empty packed tree" );
+}
+
+// The index type of the hook sets the width of the nids.
+void check_narrow_nids ( ) {
+    using NarrowTree           = sax::rooted_tree<int, sax::basic_rooted_tree_hook<std::uint16_t>>;
+    using ConcurrentNarrowTree = sax::concurrent_rooted_tree<int, sax::basic_rooted_tree_hook<std::uint16_t>>;
+    static_assert ( 8 == sizeof ( NarrowTree::hook_type ) and 2 == sizeof ( NarrowTree::nid ) );
+    static_assert ( std::is_same<NarrowTree::size_type, std::uint16_t>::value );
+    NarrowTree tree ( 1 );
+    add_nodes_low_workload ( tree, 1'000 );
+    check ( 1'000 == count_depth_first ( tree ) and 1'000 == tree.nodes.size ( ) - 1, "16 bit nids" );
+    ConcurrentNarrowTree ctree ( 1 );
+    std::vector<std::thread> threads;
+    for ( int n = 0; n < 4; ++n )
+        threads.emplace_back ( add_nodes_low_workload<ConcurrentNarrowTree>, std::ref ( ctree ), 1'001 );
+    for ( std::thread & t : threads )
+        t.join ( );
+    check ( 4'001 == count_depth_first ( ctree ), "concurrent 16 bit nids" );
+}
+
+// Counts the nodes added under the root-node of tree_, until the nids run out.
+template<typename Tree>
+[[nodiscard]] int fill_nids ( Tree & tree_ ) {
+    int count = 0;
+    try {
+        while ( true ) {
+            tree_.emplace ( tree_.root, 0 );
+            count += 1;
+        }
+    }
+    catch ( std::length_error const & ) {
+    }
+    return count;
+}
+
+// The nids of a 16 bit tree run out, instead of wrapping around (onto existing nodes).
+void check_nids_run_out ( ) {
+    using NarrowTree           = sax::rooted_tree<int, sax::basic_rooted_tree_hook<std::uint16_t>>;
+    using ConcurrentNarrowTree = sax::concurrent_rooted_tree<int, sax::basic_rooted_tree_hook<std::uint16_t>>;
+    NarrowTree tree ( 1 );
+    int const added = fill_nids ( tree );
+    check ( 65'534 == added and 65'535 == count_depth_first ( tree ) and 65'536 == tree.nodes.size ( ), "16 bit nids run out" );
+    ConcurrentNarrowTree ctree ( 1 );
+    int const cadded = fill_nids ( ctree );
+    check ( cadded > 65'535 - 2 * ConcurrentNarrowTree::thread_reserve_size and cadded + 1 == count_depth_first ( ctree ) and
+                cadded == ctree.hook ( ctree.root ).fan,
+            "concurrent 16 bit nids run out" );
+}
+
+// The lowest common ancestor, by walking the up-links.
+template<typename Tree>
+[[nodiscard]] sax::nid naive_lca ( Tree const & tree_, sax::nid a_, sax::nid b_ ) {
+    std::set<int> ancestors;
+    for ( ; a_.is_valid ( ); a_ = tree_.hook ( a_ ).up )
+        ancestors.insert ( a_.id );
+    for ( ; not ancestors.count ( b_.id ); b_ = tree_.hook ( b_ ).up )
+        ;
+    return b_;
+}
+
+// The depths, ancestors and lowest common ancestors of the index match those found by walking the up-links, also
+// for an appended leaf.
+void check_ancestor_index ( ) {
+    SequentailTree tree ( 1 );
+    add_nodes_low_workload ( tree, 10'000 );
+    sax::ancestor_index<SequentailTree> index ( tree );
+    sax::nid const leaf = tree.emplace ( sax::nid{ 5'000 }, 0 );
+    index.append ( leaf );
+    bool equal = true;
+    for ( int i = 0; i < 1'000; ++i ) {
+        sax::uniform_int_distribution<int> dis ( 1, static_cast<int> ( tree.nodes.size ( ) ) - 1 );
+        sax::nid const a{ dis ( rng ) }, b = i ? sax::nid{ dis ( rng ) } : leaf;
+        int depth = 0;
+        for ( sax::nid n = tree.hook ( a ).up; n.is_valid ( ); n = tree.hook ( n ).up )
+            depth += 1;
+        equal = equal and depth == index.depth ( a ) and tree.hook ( a ).up == index.ancestor ( a, 1 ) and
+                index.ancestor ( a, depth ) == tree.root and index.ancestor ( a, depth + 1 ).is_invalid ( );
+        equal = equal and naive_lca ( tree, a, b ) == index.lca ( a, b ) and index.is_ancestor ( index.lca ( a, b ), b );
+    }
+    check ( equal and index.depth ( leaf ) == index.depth ( sax::nid{ 5'000 } ) + 1, "ancestor_index" );
+}
+
+// A depth hook holds the depth of every node, and the height follows insertion and erasure.
+void check_depth_hook ( ) {
+    using DepthTree           = sax::rooted_tree<int, sax::depth_hook>;
+    using ConcurrentDepthTree = sax::concurrent_rooted_tree<int, sax::depth_hook>;
+    DepthTree tree ( 1 );
+    add_nodes_low_workload ( tree, 10'000 );
+    bool equal = true;
+    for ( DepthTree::const_pre_order_iterator it{ tree }; it.is_valid ( ); ++it )
+        if ( sax::nid up = tree.hook ( it.id ( ) ).up; up.is_valid ( ) )
+            equal = equal and tree.hook ( up ).depth + 1 == tree.hook ( it.id ( ) ).depth;
+    DepthTree::size_type width;
+    check ( equal and tree.height ( ) == tree.height ( tree.root, &width ), "depth hook" );
+    sax::nid deepest = tree.root;
+    for ( DepthTree::const_depth_iterator it{ tree }; it.is_valid ( ); ++it )
+        if ( tree.hook ( it.id ( ) ).depth > tree.hook ( deepest ).depth )
+            deepest = it.id ( );
+    while ( tree.hook ( tree.hook ( deepest ).up ).up.is_valid ( ) )
+        deepest = tree.hook ( deepest ).up;
+    tree.erase_subtree ( deepest ); // The child of the root-node, the deepest node is below.
+    check ( tree.height ( ) == tree.height ( tree.root, &width ), "depth hook, after erasure" );
+    ConcurrentDepthTree ctree ( 1 );
+    std::vector<std::thread> threads;
+    for ( int n = 0; n < 4; ++n )
+        threads.emplace_back ( add_nodes_low_workload<ConcurrentDepthTree>, std::ref ( ctree ), 10'001 );
+    for ( std::thread & t : threads )
+        t.join ( );
+    check ( ctree.height ( ) == ctree.height ( ctree.root, &width ), "concurrent depth hook" );
+}
+
+// The sub-tree sizes of all nodes, by a serial post-order walk.
+template<typename Tree>
+[[nodiscard]] std::vector<int> subtree_sizes ( Tree const & tree_ ) {
+    std::vector<int> sizes ( tree_.nodes.size ( ) );
+    for ( typename Tree::const_post_order_iterator it{ tree_ }; it.is_valid ( ); ++it ) {
+        sizes[ it.id ( ).id ] += 1;
+        if ( auto up = tree_.hook ( it.id ( ) ).up; up.is_valid ( ) )
+            sizes[ up.id ] += sizes[ it.id ( ).id ];
+    }
+    return sizes;
+}
+
+template<typename Tree>
+[[nodiscard]] bool has_subtree_sizes ( Tree & tree_ ) {
+    std::vector<int> const sizes = subtree_sizes ( tree_ );
+    bool equal                   = true;
+    for ( typename Tree::const_depth_iterator it{ tree_ }; it.is_valid ( ); ++it )
+        equal = equal and sizes[ it.id ( ).id ] == static_cast<int> ( tree_.subtree_size ( it.id ( ) ) );
+    return equal;
+}
+
+// The eager and lazy size hooks hold the sub-tree sizes, after insertion and erasure.
+void check_size_hooks ( ) {
+    using EagerTree           = sax::rooted_tree<int, sax::eager_size_hook>;
+    using LazyTree            = sax::rooted_tree<int, sax::lazy_size_hook>;
+    using ConcurrentEagerTree = sax::concurrent_rooted_tree<int, sax::eager_size_hook>;
+    EagerTree eager ( 1 );
+    LazyTree lazy ( 1 );
+    add_nodes_low_workload ( eager, 10'000 );
+    add_nodes_low_workload ( lazy, 10'000 );
+    check ( has_subtree_sizes ( eager ) and has_subtree_sizes ( lazy ), "size hooks" );
+    eager.erase_subtree ( eager.hook ( eager.root ).tail );
+    lazy.erase_subtree ( lazy.hook ( lazy.root ).tail );
+    check ( has_subtree_sizes ( eager ) and has_subtree_sizes ( lazy ), "size hooks, after erasure" );
+    ConcurrentEagerTree ceager ( 1 );
+    std::vector<std::thread> threads;
+    for ( int n = 0; n < 4; ++n )
+        threads.emplace_back ( add_nodes_low_workload<ConcurrentEagerTree>, std::ref ( ceager ), 10'001 );
+    for ( std::thread & t : threads )
+        t.join ( );
+    check ( 40'001 == ceager.subtree_size ( ceager.root ) and has_subtree_sizes ( ceager ), "concurrent eager size hook" );
+}
+
+// A snapshot shows the tree as it was when taken, while insertion continues: a node that only got children after
+// is a leaf in it.
+void check_snapshot ( ) {
+    using EpochTree = sax::concurrent_rooted_tree<int, sax::epoch_hook>;
+    using Snapshot  = EpochTree::snapshot_type;
+    EpochTree tree ( 1 );
+    add_nodes_low_workload ( tree, 10'000 );
+    Snapshot const snapshot = tree.snapshot ( );
+    int leaves              = 0;
+    for ( EpochTree::const_leaf_iterator it{ tree }; it.is_valid ( ); ++it )
+        leaves += 1;
+    std::vector<std::thread> threads;
+    for ( int n = 0; n < 4; ++n )
+        threads.emplace_back ( add_nodes_low_workload<EpochTree>, std::ref ( tree ), 10'001 );
+    int depth = 0, leaf = 0, internal = 0;
+    for ( Snapshot::const_depth_iterator it{ snapshot }; it.is_valid ( ); ++it )
+        depth += 1;
+    for ( Snapshot::const_leaf_iterator it{ snapshot }; it.is_valid ( ); ++it )
+        leaf += 1;
+    for ( Snapshot::const_internal_iterator it{ snapshot }; it.is_valid ( ); ++it )
+        internal += 1;
+    for ( std::thread & t : threads )
+        t.join ( );
+    std::atomic<int> visits = 0;
+    sax::parallel_for_each ( snapshot, snapshot.root, [ &visits ] ( int ) { visits += 1; } );
+    check ( 10'000 == depth and leaves == leaf and 10'000 == leaf + internal and 10'000 == visits, "snapshot" );
+    check ( 50'000 == count_depth_first ( tree ) and 10'000 == count_depth_first ( snapshot ), "snapshot after insertion" );
+}
+
+// An 8 byte payload, which makes a 12 byte vm_concurrent_vector element (not a power of 2).
+struct Pair {
+    int key = 0, tag = 0;
+};
+
+// Appends n_ elements, tagged with 1, with keys unique to the thread.
+template<typename Vector>
+void append_pairs ( Vector & vec_, int thread_, int n_ ) {
+    for ( int i = 0; i < n_; ++i )
+        vec_.emplace_back ( thread_ * n_ + i, 1 );
+}
+
+// Whether every element appended by threads_ times append_pairs ( n_ ) is in vec_ once, and all other elements are
+// untouched (zero).
+template<typename Vector>
+[[nodiscard]] bool has_pairs ( Vector const & vec_, int threads_, int n_ ) {
+    std::vector<int> found ( static_cast<std::size_t> ( threads_ * n_ ) );
+    bool clean = true;
+    for ( auto const & pair : vec_ )
+        if ( 1 == pair.tag and 0 <= pair.key and pair.key < threads_ * n_ )
+            found[ static_cast<std::size_t> ( pair.key ) ] += 1;
+        else
+            clean = clean and not pair.tag and not pair.key;
+    return clean and std::all_of ( found.begin ( ), found.end ( ), [] ( int f_ ) { return 1 == f_; } );
+}
+
+// Committing and decommitting in place, appending 12 byte elements concurrently within the chunks handed out, and
+// telling a finished thread from a running one.
+void check_vm ( ) {
+    using Vm = sax::detail::vm_vector::vm<char *>;
+    Vm vm;
+    char * const begin = vm.reserve ( 4 * Vm::page_size_b );
+    check ( begin, "vm reserve" );
+    vm.allocate ( begin, 2 * Vm::page_size_b );
+    std::memset ( begin, 1, 2 * Vm::page_size_b );
+    check ( vm.deallocate ( begin, Vm::page_size_b ) and Vm::page_size_b == vm.committed, "vm decommit" );
+    vm.allocate ( begin, Vm::page_size_b );
+    check ( 1 == begin[ 0 ] and 0 == begin[ Vm::page_size_b ], "vm, a decommitted page comes back zeroed" );
+    vm.free ( begin, 4 * Vm::page_size_b );
+    using PairVec = sax::vm_concurrent_vector<Pair, 10'000'000>;
+    static_assert ( 12 == sizeof ( PairVec::value_type ) );
+    PairVec vec;
+    std::vector<std::thread> threads;
+    for ( int n = 0; n < 4; ++n )
+        threads.emplace_back ( append_pairs<PairVec>, std::ref ( vec ), n, 100'000 );
+    for ( std::thread & t : threads )
+        t.join ( );
+    check ( has_pairs ( vec, 4, 100'000 ) and vec.size_b ( ) <= vec.m_vm.committed, "vm_concurrent_vector, 12 byte elements" );
+}
+
+// Appends n_ consecutive ints (short of the capacity, which clamps the commit), whether they are all still there (in
+// place) and the commit follows the growth policy, i.e. is a multiple of its step, or a power of 2 times its first one.
+template<typename Vector>
+[[nodiscard]] bool grows ( int n_, bool geometric_, std::size_t step_b_ ) {
+    Vector vec;
+    int const * const data = vec.data ( );
+    for ( int i = 0; i < n_; ++i )
+        vec.push_back ( i );
+    std::size_t const committed = vec.committed_b ( ), steps = committed / step_b_;
+    bool const policy           = not( committed % step_b_ ) and ( not geometric_ or not( steps & ( steps - 1 ) ) );
+    bool intact                 = data == vec.data ( ) and static_cast<std::size_t> ( n_ ) == vec.size ( );
+    for ( int i = 0; intact and i < n_; ++i )
+        intact = i == vec[ static_cast<std::size_t> ( i ) ];
+    return policy and intact and vec.size ( ) * sizeof ( int ) <= committed;
+}
+
+// Growing in place, by either policy, and throwing once the (page rounded) capacity is full.
+void check_vm_vector ( ) {
+    constexpr std::size_t page_b = sax::detail::vm_vector::vm<int *>::page_size_b;
+    check ( grows<sax::vm_vector<int, 1'000'000, sax::detail::vm_vector::linear_growth<3 * page_b>>> ( 500'000, false, 3 * page_b ),
+            "vm_vector, linear growth" );
+    check ( grows<sax::vm_vector<int, 1'000'000, sax::detail::vm_vector::geometric_growth<page_b>>> ( 500'000, true, page_b ),
+            "vm_vector, geometric growth" );
+    sax::vm_vector<int, page_b / sizeof ( int ), sax::detail::vm_vector::linear_growth<page_b>> full;
+    for ( std::size_t i = 0; i < full.capacity ( ); ++i )
+        full.push_back ( 1 );
+    bool threw = false;
+    try {
+        full.push_back ( 1 );
+    }
+    catch ( std::bad_alloc const & ) {
+        threw = true;
+    }
+    check ( threw and page_b == full.committed_b ( ), "vm_vector, full" );
+}
+
+// Huge page backed containers (explicit ones, or transparent ones, whatever the system has got) are aligned to, and
+// commit in, 2MB, hold their contents, and count no more huge backed bytes than are committed.
+void check_huge_pages ( ) {
+    using HugeVm = sax::detail::vm_vector::vm<char *, true>;
+    static_assert ( 2 * 1'024 * 1'024 == HugeVm::page_size_b );
+    HugeVm vm;
+    char * const begin = vm.reserve ( 4 * HugeVm::page_size_b );
+    check ( begin and not( reinterpret_cast<std::uintptr_t> ( begin ) % HugeVm::page_size_b ), "huge vm reserve" );
+    vm.allocate ( begin, 2 * HugeVm::page_size_b );
+    std::memset ( begin, 1, 2 * HugeVm::page_size_b );
+    check ( vm.deallocate ( begin, HugeVm::page_size_b ) and vm.huge_b ( begin ) <= vm.committed, "huge vm decommit" );
+    vm.allocate ( begin, HugeVm::page_size_b );
+    check ( 1 == begin[ 0 ] and 0 == begin[ HugeVm::page_size_b ], "huge vm, a decommitted page comes back zeroed" );
+    vm.free ( begin, 4 * HugeVm::page_size_b );
+    sax::vm_vector<int, 4'000'000, sax::detail::vm_vector::geometric_growth<>, true> vec;
+    for ( int i = 0; i < 3'000'000; ++i )
+        vec.push_back ( i );
+    bool intact = not( reinterpret_cast<std::uintptr_t> ( vec.data ( ) ) % HugeVm::page_size_b ) and
+                  not( vec.committed_b ( ) % HugeVm::page_size_b ) and vec.huge_b ( ) <= vec.committed_b ( ) and
+                  sax::detail::vm_vector::transparent_huge_b ( vec.data ( ), vec.data ( ) + 1 ) <= sizeof ( int ); // Clipped.
+    for ( int i = 0; intact and i < 3'000'000; ++i )
+        intact = i == vec[ static_cast<std::size_t> ( i ) ];
+    check ( intact, "huge vm_vector" );
+    using PairVec = sax::vm_concurrent_vector<Pair, 10'000'000, true>;
+    PairVec pairs;
+    std::vector<std::thread> threads;
+    for ( int n = 0; n < 4; ++n )
+        threads.emplace_back ( append_pairs<PairVec>, std::ref ( pairs ), n, 100'000 );
+    for ( std::thread & t : threads )
+        t.join ( );
+    check ( has_pairs ( pairs, 4, 100'000 ) and pairs.huge_b ( ) <= pairs.m_vm.committed, "huge vm_concurrent_vector" );
+}
+
+// Appending 12 byte elements concurrently, past a commit step, with the prefault thread committing ahead.
+void check_prefault ( ) {
+    using PairVec = sax::vm_concurrent_vector<Pair, 10'000'000>;
+    PairVec vec;
+    vec.start_prefault ( );
+    std::vector<std::thread> threads;
+    for ( int n = 0; n < 4; ++n )
+        threads.emplace_back ( append_pairs<PairVec>, std::ref ( vec ), n, 1'500'000 );
+    for ( std::thread & t : threads )
+        t.join ( );
+    vec.stop_prefault ( );
+    check ( has_pairs ( vec, 4, 1'500'000 ) and vec.size_b ( ) <= vec.m_vm.committed, "prefault" );
+}
+
+// Appending 12 byte elements concurrently from per node slabs, which stay on the element grid, and account for
+// (at least) the chunks handed out.
+void check_numa_slabs ( ) {
+    using PairVec = sax::vm_concurrent_vector<Pair, 10'000'000>;
+    PairVec vec;
+    vec.numa_slabs ( 1'000'000 );
+    std::vector<std::thread> threads;
+    for ( int n = 0; n < 4; ++n )
+        threads.emplace_back ( append_pairs<PairVec>, std::ref ( vec ), n, 100'000 );
+    for ( std::thread & t : threads )
+        t.join ( );
+    PairVec::numa_usage total;
+    for ( unsigned node = 0; node < sax::detail::numa_max_nodes; ++node ) {
+        PairVec::numa_usage const usage = vec.numa_node_usage ( node );
+        check ( usage.chunks_b <= usage.slabs_b and usage.bound_b <= usage.slabs_b, "numa slabs, usage of a node" );
+        check ( not( usage.slabs_b % PairVec::vm::page_size_b ), "numa slabs, whole pages" );
+        total.slabs_b += usage.slabs_b;
+        total.chunks_b += usage.chunks_b;
+    }
+    check ( has_pairs ( vec, 4, 100'000 ) and 4 * 100'000 * sizeof ( PairVec::value_type ) <= total.chunks_b and
+                total.slabs_b <= vec.m_vm.committed and vec.size_b ( ) <= vec.m_vm.committed,
+            "numa slabs" );
+}
+
+// A new and a recycled node are initialized alike, a vector payload is not built from an initializer list.
+void check_payload_init ( ) {
+    using VectorTree           = sax::rooted_tree<std::vector<int>>;
+    using ConcurrentVectorTree = sax::concurrent_rooted_tree<std::vector<int>>;
+    VectorTree tree ( 1, 0 );
+    sax::nid a = tree.emplace ( tree.root, 3, 1 );
+    check ( 3 == tree[ a ].size ( ), "a new node is initialized with parentheses" );
+    tree.erase_subtree ( a );
+    a = tree.emplace ( tree.root, 3, 1 );
+    check ( 3 == tree[ a ].size ( ), "a recycled node is initialized with parentheses" );
+    ConcurrentVectorTree ctree ( 1, 0 );
+    sax::nid const c = ctree.emplace ( ctree.root, 3, 1 );
+    check ( 3 == ctree[ c ].size ( ), "a reserved node is initialized with parentheses" );
+}
+
+void run_checks ( ) {
+    check_concurrent_insert ( );
+    check_concurrent_siblings ( );
+    check_concurrent_publish ( );
+    check_erase_subtree ( );
+    check_reroot ( );
+    check_relayout ( );
+    check_split_hooks ( );
+    check_scratch_iterators ( );
+    check_stackless_iterators ( );
+    check_parallel_for_each ( );
+    check_height ( );
+    check_reduce_up ( );
+    check_propagate_down ( );
+    check_mapped ( );
+    check_packed ( );
+    check_narrow_nids ( );
+    check_nids_run_out ( );
+    check_ancestor_index ( );
+    check_depth_hook ( );
+    check_size_hooks ( );
+    check_snapshot ( );
+    check_vm ( );
+    check_vm_vector ( );
+    check_huge_pages ( );
+    check_prefault ( );
+    check_numa_slabs ( );
+    check_payload_init ( );
+    std::cout << "checks passed" << nl;
 }
 
 int main75675 ( ) {
@@ -847,6 +1636,8 @@ std::cout << duration << "ms" << sp << vec.size ( ) << nl;
 
 int main ( ) {
 
+    run_checks ( );
+
     /*
 
     type_instance_thread_local<Bar, int> ins;